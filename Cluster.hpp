@@ -0,0 +1,760 @@
+/*
+ * Sean Malloy
+ * Cluster.hpp
+ * Coordinator and worker processes for batch solving over TCP.
+ *
+ * Every message is a frame: a 4 byte big-endian payload length, a 1 byte
+ * message type, then the payload. Integers are big-endian and strings are a
+ * 4 byte length followed by raw bytes.
+ *
+ *   HELLO    worker -> coordinator  (empty)
+ *   JOB      coordinator -> worker  u64 id, u32 threads, u32 budgetMs,
+ *                                   str algorithm, str scramble
+ *   RESULT   worker -> coordinator  u64 id, u64 elapsed (us), str solution
+ *   SHUTDOWN coordinator -> worker  (empty)
+ *   ERROR    worker -> coordinator  u64 id, str message
+ *
+ * A worker answers a job its handler throws on with ERROR and carries on,
+ * so one bad job fails alone instead of taking down every worker it is
+ * retried on.
+ */
+
+#ifndef CLUSTER_HPP
+#define CLUSTER_HPP
+
+/************************************************/
+// System includes
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Timer.hpp"
+
+/************************************************/
+
+const uint32_t MAX_FRAME_SIZE       = 1 << 20;
+const unsigned JOB_WINDOW           = 2;
+const unsigned MAX_JOB_ATTEMPTS     = 3;
+const int      CONNECT_RETRY_COUNT  = 50;
+const int      POLL_INTERVAL_MS     = 50;
+const double   WORKER_WAIT_MS       = 30000;
+
+enum class MessageType : uint8_t { HELLO = 1, JOB = 2, RESULT = 3, SHUTDOWN = 4, ERROR = 5 };
+
+struct Job
+{
+  uint64_t id;
+  uint32_t threads;
+  uint32_t budgetMs;
+  std::string algorithm;
+  std::string scramble;
+};
+
+struct JobResult
+{
+  uint64_t id;
+  uint64_t elapsedUs;
+  std::string solution;
+};
+
+// Solves one job inside a worker process and returns the solution string.
+typedef std::function<std::string(const Job&)> jobHandler_t;
+
+/************************************************/
+
+// Builds one frame, filling in the length prefix on finish().
+class FrameWriter
+{
+public:
+  explicit FrameWriter(MessageType type)
+    : m_bytes(4, 0)
+  {
+    m_bytes.push_back((uint8_t) type);
+  }
+
+  void
+  putU32(uint32_t v)
+  {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      m_bytes.push_back((uint8_t) (v >> shift));
+  }
+
+  void
+  putU64(uint64_t v)
+  {
+    putU32((uint32_t) (v >> 32));
+    putU32((uint32_t) v);
+  }
+
+  void
+  putString(const std::string& s)
+  {
+    putU32((uint32_t) s.size());
+    m_bytes.insert(m_bytes.end(), s.begin(), s.end());
+  }
+
+  const std::vector<uint8_t>&
+  finish()
+  {
+    uint32_t length = (uint32_t) (m_bytes.size() - 4);
+    for (int i = 0; i < 4; ++i)
+      m_bytes[i] = (uint8_t) (length >> (24 - 8 * i));
+
+    return m_bytes;
+  }
+
+private:
+  std::vector<uint8_t> m_bytes;
+};
+
+/************************************************/
+
+// Bounds-checked reader over one frame payload. Every get returns false once
+// the payload runs out.
+class FrameReader
+{
+public:
+  FrameReader(const uint8_t* data, size_t size)
+    : m_data(data),
+      m_size(size),
+      m_pos(0)
+  { }
+
+  bool
+  getU32(uint32_t& v)
+  {
+    if (m_size - m_pos < 4)
+      return false;
+
+    v = 0;
+    for (int i = 0; i < 4; ++i)
+      v = (v << 8) | m_data[m_pos++];
+    return true;
+  }
+
+  bool
+  getU64(uint64_t& v)
+  {
+    uint32_t hi, lo;
+    if (!getU32(hi) || !getU32(lo))
+      return false;
+
+    v = ((uint64_t) hi << 32) | lo;
+    return true;
+  }
+
+  bool
+  getString(std::string& s)
+  {
+    uint32_t length;
+    if (!getU32(length) || m_size - m_pos < length)
+      return false;
+
+    s.assign((const char*) m_data + m_pos, length);
+    m_pos += length;
+    return true;
+  }
+
+private:
+  const uint8_t* m_data;
+  size_t m_size;
+  size_t m_pos;
+};
+
+/************************************************/
+
+// Writes the whole buffer, returning false if the peer went away. Blocks
+// until everything is sent, so only workers use it.
+inline bool
+sendAll(int fd, const std::vector<uint8_t>& bytes)
+{
+  size_t sent = 0;
+  while (sent < bytes.size())
+  {
+    ssize_t n = send(fd, bytes.data() + sent, bytes.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+
+    sent += n;
+  }
+
+  return true;
+}
+
+// Pulls every complete frame off the front of 'buffer' into 'frames' as
+// (type, payload) pairs. Returns false on a malformed or oversized frame.
+inline bool
+extractFrames(std::vector<uint8_t>& buffer, std::vector<std::pair<MessageType, std::vector<uint8_t>>>& frames)
+{
+  size_t pos = 0;
+  while (buffer.size() - pos >= 5)
+  {
+    uint32_t length = ((uint32_t) buffer[pos] << 24) | ((uint32_t) buffer[pos + 1] << 16) |
+                      ((uint32_t) buffer[pos + 2] << 8) | buffer[pos + 3];
+    if (length == 0 || length > MAX_FRAME_SIZE)
+      return false;
+    if (buffer.size() - pos - 4 < length)
+      break;
+
+    MessageType type = (MessageType) buffer[pos + 4];
+    frames.emplace_back(type, std::vector<uint8_t>(buffer.begin() + pos + 5, buffer.begin() + pos + 4 + length));
+    pos += 4 + length;
+  }
+
+  buffer.erase(buffer.begin(), buffer.begin() + pos);
+  return true;
+}
+
+// Blocking read of exactly one frame. Returns false on EOF or error.
+inline bool
+readFrame(int fd, MessageType& type, std::vector<uint8_t>& payload)
+{
+  std::vector<uint8_t> buffer;
+  std::vector<std::pair<MessageType, std::vector<uint8_t>>> frames;
+  uint8_t chunk[4096];
+
+  // Read the header first, then exactly the rest of the frame, so nothing
+  // belonging to the next frame is consumed.
+  size_t want = 5;
+  while (frames.size() == 0)
+  {
+    while (buffer.size() < want)
+    {
+      ssize_t n = read(fd, chunk, std::min(sizeof(chunk), want - buffer.size()));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+
+      buffer.insert(buffer.end(), chunk, chunk + n);
+    }
+
+    uint32_t length = ((uint32_t) buffer[0] << 24) | ((uint32_t) buffer[1] << 16) |
+                      ((uint32_t) buffer[2] << 8) | buffer[3];
+    want = 4 + (size_t) length;
+    if (!extractFrames(buffer, frames))
+      return false;
+  }
+
+  type = frames[0].first;
+  payload = std::move(frames[0].second);
+  return true;
+}
+
+/************************************************/
+
+// Worker process main loop. Connects to the coordinator, then solves jobs
+// one at a time until told to shut down. Anything 'handler' loads up front
+// (e.g. lookup tables) is shared by every job this process runs.
+inline int
+runWorker(const std::string& host, const std::string& port, const jobHandler_t& handler)
+{
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  addrinfo* addrs;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs) != 0)
+  {
+    fprintf(stderr, "Worker: cannot resolve %s:%s\n", host.c_str(), port.c_str());
+    return 1;
+  }
+
+  // The coordinator may still be starting up, so retry for a few seconds
+  int fd = -1;
+  for (int attempt = 0; attempt < CONNECT_RETRY_COUNT && fd < 0; ++attempt)
+  {
+    for (addrinfo* a = addrs; a != nullptr && fd < 0; a = a->ai_next)
+    {
+      fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+      {
+        close(fd);
+        fd = -1;
+      }
+    }
+
+    if (fd < 0)
+      usleep(100 * 1000);
+  }
+  freeaddrinfo(addrs);
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "Worker: cannot connect to %s:%s\n", host.c_str(), port.c_str());
+    return 1;
+  }
+
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  FrameWriter hello(MessageType::HELLO);
+  if (!sendAll(fd, hello.finish()))
+  {
+    close(fd);
+    return 1;
+  }
+
+  MessageType type;
+  std::vector<uint8_t> payload;
+  while (readFrame(fd, type, payload))
+  {
+    if (type == MessageType::SHUTDOWN)
+      break;
+    if (type != MessageType::JOB)
+      continue;
+
+    Job job;
+    FrameReader reader(payload.data(), payload.size());
+    if (!reader.getU64(job.id) || !reader.getU32(job.threads) || !reader.getU32(job.budgetMs) ||
+        !reader.getString(job.algorithm) || !reader.getString(job.scramble))
+    {
+      fprintf(stderr, "Worker: malformed job\n");
+      break;
+    }
+
+    Timer t;
+    t.start();
+    std::string solution, error;
+    try
+    {
+      solution = handler(job);
+    }
+    catch (const std::exception& e)
+    {
+      error = e.what();
+    }
+    t.stop();
+
+    FrameWriter result(error.size() > 0 ? MessageType::ERROR : MessageType::RESULT);
+    result.putU64(job.id);
+    if (error.size() > 0)
+      result.putString(error);
+    else
+    {
+      result.putU64((uint64_t) (t.elapsed() * 1000));
+      result.putString(solution);
+    }
+    if (!sendAll(fd, result.finish()))
+      break;
+  }
+
+  close(fd);
+  return 0;
+}
+
+/************************************************/
+
+// Coordinator for a batch of jobs. Workers pull up to JOB_WINDOW jobs at a
+// time, so slower workers are handed less work. When the queue is empty and
+// a worker is idle, any job that has been out longer than 'jobTimeoutMs' is
+// re-issued to it and the first result wins. Jobs held by a worker that
+// disconnects are requeued, up to MAX_JOB_ATTEMPTS times. Results are written
+// to 'out' in input order as soon as every earlier job is done. A job a
+// worker reports an error for fails at once, since any worker would fail it.
+//
+// Worker sockets are non-blocking and frames queue per connection until the
+// socket takes them, so a worker that stops reading cannot stall the others.
+// If no worker is connected for WORKER_WAIT_MS, every unfinished job fails.
+class Coordinator
+{
+  using clock = std::chrono::steady_clock;
+
+  struct JobState
+  {
+    Job job;
+    unsigned attempts = 0;
+    unsigned outstanding = 0;
+    bool done = false;
+    bool failed = false;
+    JobResult result;
+  };
+
+  struct Connection
+  {
+    int fd;
+    bool ready = false;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+    std::map<size_t, clock::time_point> inflight;
+  };
+
+public:
+  Coordinator(const std::vector<Job>& jobs, double jobTimeoutMs)
+    : m_jobs(),
+      m_pending(),
+      m_connections(),
+      m_listenFd(-1),
+      m_jobTimeoutMs(jobTimeoutMs),
+      m_nextOutput(0),
+      m_remaining(jobs.size())
+  {
+    for (const auto& job : jobs)
+    {
+      JobState state;
+      state.job = job;
+      m_jobs.push_back(state);
+      m_pending.push_back(m_jobs.size() - 1);
+    }
+  }
+
+  ~Coordinator()
+  {
+    for (auto& c : m_connections)
+      close(c.fd);
+    if (m_listenFd >= 0)
+      close(m_listenFd);
+  }
+
+  // Listens on 'port' and runs until every job is done or failed. Returns 0
+  // if every job was solved.
+  int
+  run(uint16_t port, std::ostream& out)
+  {
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(m_listenFd, (sockaddr*) &addr, sizeof(addr)) != 0 || listen(m_listenFd, 64) != 0)
+    {
+      fprintf(stderr, "Coordinator: cannot listen on port %u (%s)\n", port, strerror(errno));
+      return 1;
+    }
+
+    clock::time_point lastWorker = clock::now();
+    while (m_remaining > 0)
+    {
+      std::vector<pollfd> fds;
+      fds.push_back({ m_listenFd, POLLIN, 0 });
+      for (auto& c : m_connections)
+        fds.push_back({ c.fd, (short) (c.output.size() > 0 ? POLLIN | POLLOUT : POLLIN), 0 });
+
+      if (poll(fds.data(), fds.size(), POLL_INTERVAL_MS) < 0 && errno != EINTR)
+        return 1;
+
+      if (fds[0].revents & POLLIN)
+        acceptWorker();
+
+      // Walk backwards so dropped connections can be erased in place
+      for (size_t i = fds.size() - 1; i > 0; --i)
+      {
+        bool alive = true;
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+          alive = readWorker(m_connections[i - 1]);
+        if (alive && (fds[i].revents & POLLOUT))
+          alive = writeWorker(m_connections[i - 1]);
+        if (!alive)
+          dropWorker(i - 1);
+      }
+
+      if (m_connections.size() > 0)
+        lastWorker = clock::now();
+      else if (std::chrono::duration<double, std::milli>(clock::now() - lastWorker).count() >= WORKER_WAIT_MS)
+      {
+        fprintf(stderr, "Coordinator: no worker connected for %.0f s, giving up\n", WORKER_WAIT_MS / 1000);
+        failRemaining();
+        flushOutput(out);
+        return 1;
+      }
+
+      dispatch();
+      rebalance();
+      flushOutput(out);
+    }
+
+    // Jobs rejected before the run never enter the loop
+    flushOutput(out);
+
+    // Best effort, since a stalled worker must not hold up the exit. Workers
+    // also stop when the connection closes.
+    FrameWriter shutdown(MessageType::SHUTDOWN);
+    const auto& bytes = shutdown.finish();
+    for (auto& c : m_connections)
+    {
+      c.output.insert(c.output.end(), bytes.begin(), bytes.end());
+      writeWorker(c);
+    }
+
+    for (const auto& j : m_jobs)
+      if (j.failed)
+        return 1;
+    return 0;
+  }
+
+  // Fails job 'id' before it is ever dispatched, e.g. for input the workers
+  // could not parse
+  void
+  reject(size_t id)
+  {
+    JobState& job = m_jobs[id];
+    if (!job.done && !job.failed)
+    {
+      job.failed = true;
+      --m_remaining;
+    }
+  }
+
+private:
+  void
+  acceptWorker()
+  {
+    int fd = accept(m_listenFd, nullptr, nullptr);
+    if (fd < 0)
+      return;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    Connection c;
+    c.fd = fd;
+    m_connections.push_back(c);
+  }
+
+  // Returns false if the worker disconnected or sent garbage
+  bool
+  readWorker(Connection& c)
+  {
+    uint8_t chunk[4096];
+    ssize_t n = read(c.fd, chunk, sizeof(chunk));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+      return true;
+    if (n <= 0)
+      return false;
+
+    c.input.insert(c.input.end(), chunk, chunk + n);
+
+    std::vector<std::pair<MessageType, std::vector<uint8_t>>> frames;
+    if (!extractFrames(c.input, frames))
+      return false;
+
+    for (const auto& frame : frames)
+    {
+      if (frame.first == MessageType::HELLO)
+      {
+        c.ready = true;
+        continue;
+      }
+      if (frame.first == MessageType::ERROR)
+      {
+        uint64_t id;
+        std::string message;
+        FrameReader reader(frame.second.data(), frame.second.size());
+        if (!reader.getU64(id) || !reader.getString(message) || id >= m_jobs.size())
+          return false;
+
+        fprintf(stderr, "Coordinator: job %zu failed (%s)\n", (size_t) id, message.c_str());
+        if (c.inflight.erase(id) > 0)
+          --m_jobs[id].outstanding;
+        reject(id);
+        continue;
+      }
+      if (frame.first != MessageType::RESULT)
+        return false;
+
+      JobResult result;
+      FrameReader reader(frame.second.data(), frame.second.size());
+      if (!reader.getU64(result.id) || !reader.getU64(result.elapsedUs) || !reader.getString(result.solution) ||
+          result.id >= m_jobs.size())
+        return false;
+
+      JobState& job = m_jobs[result.id];
+      if (c.inflight.erase(result.id) > 0)
+        --job.outstanding;
+
+      if (!job.done && !job.failed)
+      {
+        job.done = true;
+        job.result = result;
+        --m_remaining;
+      }
+    }
+
+    return true;
+  }
+
+  // Requeues every unfinished job the worker held
+  void
+  dropWorker(size_t index)
+  {
+    Connection& c = m_connections[index];
+    for (const auto& entry : c.inflight)
+    {
+      JobState& job = m_jobs[entry.first];
+      --job.outstanding;
+      if (job.done || job.failed || job.outstanding > 0)
+        continue;
+
+      if (++job.attempts >= MAX_JOB_ATTEMPTS)
+      {
+        fprintf(stderr, "Coordinator: giving up on job %zu after %u worker failures\n", entry.first, job.attempts);
+        job.failed = true;
+        --m_remaining;
+      }
+      else
+        m_pending.push_front(entry.first);
+    }
+
+    close(c.fd);
+    m_connections.erase(m_connections.begin() + index);
+  }
+
+  // Sends as much queued output as the socket takes without blocking.
+  // Returns false if the worker disconnected.
+  bool
+  writeWorker(Connection& c)
+  {
+    size_t sent = 0;
+    while (sent < c.output.size())
+    {
+      ssize_t n = send(c.fd, c.output.data() + sent, c.output.size() - sent, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      if (n <= 0)
+        return false;
+
+      sent += n;
+    }
+
+    c.output.erase(c.output.begin(), c.output.begin() + sent);
+    return true;
+  }
+
+  // Queues the job on the worker's connection. The job counts as held by the
+  // worker from here on, so dropWorker() requeues it if the send fails.
+  bool
+  issue(Connection& c, size_t index)
+  {
+    const Job& job = m_jobs[index].job;
+    FrameWriter frame(MessageType::JOB);
+    frame.putU64(index);
+    frame.putU32(job.threads);
+    frame.putU32(job.budgetMs);
+    frame.putString(job.algorithm);
+    frame.putString(job.scramble);
+    const auto& bytes = frame.finish();
+    c.output.insert(c.output.end(), bytes.begin(), bytes.end());
+
+    c.inflight[index] = clock::now();
+    ++m_jobs[index].outstanding;
+    return writeWorker(c);
+  }
+
+  // Fails every job that is not done yet
+  void
+  failRemaining()
+  {
+    for (auto& j : m_jobs)
+      if (!j.done && !j.failed)
+      {
+        j.failed = true;
+        --m_remaining;
+      }
+  }
+
+  void
+  dispatch()
+  {
+    for (auto& c : m_connections)
+    {
+      while (c.ready && c.inflight.size() < JOB_WINDOW && m_pending.size() > 0)
+      {
+        size_t index = m_pending.front();
+        m_pending.pop_front();
+        if (m_jobs[index].done || m_jobs[index].failed)
+          continue;
+
+        // A failed send means the worker is gone. Its socket will report the
+        // hangup on the next poll and dropWorker() requeues its jobs.
+        if (!issue(c, index))
+          break;
+      }
+    }
+  }
+
+  // Hands the oldest overdue job to an idle worker so one slow or stuck
+  // worker cannot hold up the tail of the batch.
+  void
+  rebalance()
+  {
+    if (m_pending.size() > 0)
+      return;
+
+    for (auto& idle : m_connections)
+    {
+      if (!idle.ready || idle.inflight.size() > 0)
+        continue;
+
+      size_t oldest = m_jobs.size();
+      clock::time_point oldestTime = clock::now();
+      for (const auto& c : m_connections)
+        for (const auto& entry : c.inflight)
+          if (!m_jobs[entry.first].done && m_jobs[entry.first].outstanding == 1 && entry.second < oldestTime)
+          {
+            oldest = entry.first;
+            oldestTime = entry.second;
+          }
+
+      std::chrono::duration<double, std::milli> age = clock::now() - oldestTime;
+      if (oldest == m_jobs.size() || age.count() < m_jobTimeoutMs)
+        return;
+
+      issue(idle, oldest);
+    }
+  }
+
+  void
+  flushOutput(std::ostream& out)
+  {
+    while (m_nextOutput < m_jobs.size() && (m_jobs[m_nextOutput].done || m_jobs[m_nextOutput].failed))
+    {
+      const JobState& job = m_jobs[m_nextOutput];
+      if (job.failed)
+        out << "FAILED\n";
+      else
+        out << job.result.solution << '\t' << job.result.elapsedUs / 1000.0 << " ms\n";
+      out.flush();
+      ++m_nextOutput;
+    }
+  }
+
+  std::vector<JobState> m_jobs;
+  std::deque<size_t> m_pending;
+  std::vector<Connection> m_connections;
+  int m_listenFd;
+  double m_jobTimeoutMs;
+  size_t m_nextOutput;
+  size_t m_remaining;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <unordered_map>
+#include <cstdint>
 
 #ifndef CYCLES_H
 #define CYCLES_H
@@ -11,6 +12,7 @@ const unsigned CYCLE_LENGTH      = 4;
 const unsigned CYCLE_COUNT       = 5;
 const unsigned START_MOVE_COUNT  = 18;
 const unsigned UNIQUE_EDGE_COUNT = 12;
+const unsigned MOVED_PIECE_COUNT = 20;
 constexpr char MOVE_NAMES[7]     = "ULFRBD";
 constexpr char OPP_MOVE_NAMES[7] = "DRBLFU";
 constexpr char COLOR_NAMES[7]    = "WOGRBY";
@@ -27,5 +29,27 @@ const int MOVE_CYCLES[6][5][4]
 
 const int EDGES[12] = { 1, 3, 4, 6, 10, 11, 13, 20, 22, 28, 31, 38 };
 
+const unsigned CORNER_COUNT        = 8;
+const unsigned EDGE_COUNT          = 12;
+const uint64_t CORNER_PERM_COUNT   = 40320;      // 8!
+const uint64_t CORNER_ORIENT_COUNT = 2187;       // 3^7
+const uint64_t EDGE_PERM_COUNT     = 479001600;  // 12!
+const uint64_t EDGE_ORIENT_COUNT   = 2048;       // 2^11
+
+// Facelets of each corner slot in a consistent cyclic order, U/D facelet first.
+// Slot i holds cubie i when solved.
+const int CORNER_FACELETS[8][3]
+{
+  {  0,  8, 34 }, {  2, 32, 26 }, {  5, 16, 10 }, {  7, 24, 18 },
+  { 45, 39, 13 }, { 40, 15, 21 }, { 42, 23, 29 }, { 47, 31, 37 }
+};
+
+// Facelets of each edge slot, U/D facelet first, otherwise F/B facelet first
+const int EDGE_FACELETS[12][2]
+{
+  {  1, 33 }, {  3,  9 }, {  4, 25 }, {  6, 17 }, { 36, 11 }, { 19, 12 },
+  { 43, 14 }, { 20, 27 }, { 41, 22 }, { 35, 28 }, { 44, 30 }, { 46, 38 }
+};
+
 const std::unordered_map<char, unsigned> m_moveMap { {'U', 0}, {'L', 1}, {'F', 2}, {'R', 3}, {'B', 4}, {'D', 5} };
 #endif
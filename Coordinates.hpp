@@ -0,0 +1,291 @@
+/*
+ * Sean Malloy
+ * Coordinates.hpp
+ * Small integer coordinates for depth-first searches. A state is tracked as
+ * its corner twist, edge flip, corner permutation and the positions of the
+ * four E-slice edges. Each is updated per move by one load from a
+ * coordinate x move table, and the lower bound is the largest of three
+ * pruning tables indexed by them, so a search never touches the 48-facelet
+ * cube until it needs to verify a candidate solution.
+ *
+ * The move tables are generated by turning cubes built from each coordinate
+ * value, i.e. from MOVE_CYCLES, and the pruning tables by breadth-first
+ * search over the coordinates.
+ */
+
+#ifndef COORDINATES_HPP
+#define COORDINATES_HPP
+
+/************************************************/
+// System includes
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Peephole.hpp"
+
+/************************************************/
+
+const unsigned SLICE_EDGE_COUNT = 4;
+const unsigned SLICE_COUNT      = 495;   // 12 choose 4
+
+const uint8_t UNVISITED = 0xFF;
+
+struct CoordState
+{
+  uint16_t twist;
+  uint16_t flip;
+  uint16_t cornerPerm;
+  uint16_t slice;
+};
+
+/************************************************/
+
+// n choose k for n <= EDGE_COUNT and k <= SLICE_EDGE_COUNT
+struct Binomials
+{
+  unsigned value[EDGE_COUNT + 1][SLICE_EDGE_COUNT + 1];
+};
+
+constexpr Binomials
+makeBinomials()
+{
+  Binomials b {};
+  for (unsigned n = 0; n <= EDGE_COUNT; ++n)
+  {
+    b.value[n][0] = 1;
+    for (unsigned k = 1; k <= SLICE_EDGE_COUNT && k <= n; ++k)
+      b.value[n][k] = b.value[n - 1][k - 1] + (k < n ? b.value[n - 1][k] : 0);
+  }
+
+  return b;
+}
+
+constexpr Binomials BINOMIALS = makeBinomials();
+
+/************************************************/
+
+class CoordTables
+{
+public:
+  CoordTables()
+    : m_isSlice(),
+      m_sliceEdges(),
+      m_twistMove(CORNER_ORIENT_COUNT * START_MOVE_COUNT),
+      m_flipMove(EDGE_ORIENT_COUNT * START_MOVE_COUNT),
+      m_cornerPermMove(CORNER_PERM_COUNT * START_MOVE_COUNT),
+      m_sliceMove(SLICE_COUNT * START_MOVE_COUNT),
+      m_twistSlice(),
+      m_flipSlice(),
+      m_cornerPerm(),
+      m_solved()
+  {
+    // E-slice edges are the ones with neither a U nor a D facelet
+    const unsigned up = strchr(MOVE_NAMES, 'U') - MOVE_NAMES, down = strchr(MOVE_NAMES, 'D') - MOVE_NAMES;
+    for (unsigned e = 0; e < EDGE_COUNT; ++e)
+    {
+      unsigned a = EDGE_FACELETS[e][0] / SIDE_PIECE_COUNT, b = EDGE_FACELETS[e][1] / SIDE_PIECE_COUNT;
+      m_isSlice[e] = a != up && a != down && b != up && b != down;
+      if (m_isSlice[e])
+        m_sliceEdges.push_back(e);
+    }
+
+    m_solved = fromCube(Cube());
+
+    buildMoves(m_twistMove, CORNER_ORIENT_COUNT,
+               [](unsigned v) { return Cube::fromCornerRank(v); },
+               [](const Cube& c) { return c.cornerOrientRank(); });
+    buildMoves(m_flipMove, EDGE_ORIENT_COUNT,
+               [](unsigned v) { return Cube::fromEdgeRank(v); },
+               [](const Cube& c) { return c.edgeOrientRank(); });
+    buildMoves(m_cornerPermMove, CORNER_PERM_COUNT,
+               [](unsigned v) { return Cube::fromCornerRank(v * CORNER_ORIENT_COUNT); },
+               [](const Cube& c) { return c.cornerPermRank(); });
+    buildMoves(m_sliceMove, SLICE_COUNT,
+               [this](unsigned v) { return sliceCube(v); },
+               [this](const Cube& c) { return sliceRank(c); });
+
+    buildPruning(m_twistSlice, CORNER_ORIENT_COUNT * SLICE_COUNT, m_solved.twist * SLICE_COUNT + m_solved.slice,
+                 [this](uint32_t i, unsigned m)
+                 {
+                   return m_twistMove[i / SLICE_COUNT * START_MOVE_COUNT + m] * SLICE_COUNT +
+                          m_sliceMove[i % SLICE_COUNT * START_MOVE_COUNT + m];
+                 });
+    buildPruning(m_flipSlice, EDGE_ORIENT_COUNT * SLICE_COUNT, m_solved.flip * SLICE_COUNT + m_solved.slice,
+                 [this](uint32_t i, unsigned m)
+                 {
+                   return m_flipMove[i / SLICE_COUNT * START_MOVE_COUNT + m] * SLICE_COUNT +
+                          m_sliceMove[i % SLICE_COUNT * START_MOVE_COUNT + m];
+                 });
+    buildPruning(m_cornerPerm, CORNER_PERM_COUNT, m_solved.cornerPerm,
+                 [this](uint32_t i, unsigned m) { return m_cornerPermMove[i * START_MOVE_COUNT + m]; });
+  }
+
+  // Shared tables, built on first use
+  static const CoordTables&
+  instance()
+  {
+    static CoordTables tables;
+    return tables;
+  }
+
+  CoordState
+  fromCube(const Cube& cube) const
+  {
+    CoordState c;
+    c.twist = cube.cornerOrientRank();
+    c.flip = cube.edgeOrientRank();
+    c.cornerPerm = cube.cornerPermRank();
+    c.slice = sliceRank(cube);
+    return c;
+  }
+
+  // Coordinates after move 'code' (see Peephole.hpp)
+  CoordState
+  move(const CoordState& c, uint8_t code) const
+  {
+    CoordState next;
+    next.twist = m_twistMove[c.twist * START_MOVE_COUNT + code];
+    next.flip = m_flipMove[c.flip * START_MOVE_COUNT + code];
+    next.cornerPerm = m_cornerPermMove[c.cornerPerm * START_MOVE_COUNT + code];
+    next.slice = m_sliceMove[c.slice * START_MOVE_COUNT + code];
+    return next;
+  }
+
+  // Admissible: each table is the exact distance of a projection of the
+  // state. 0 does not imply solved, since edge permutation is not tracked.
+  unsigned
+  lowerBound(const CoordState& c) const
+  {
+    unsigned h = m_twistSlice[c.twist * SLICE_COUNT + c.slice];
+    unsigned flip = m_flipSlice[c.flip * SLICE_COUNT + c.slice];
+    unsigned corners = m_cornerPerm[c.cornerPerm];
+    h = flip > h ? flip : h;
+    return corners > h ? corners : h;
+  }
+
+  // Admissible bound on the moves to the subgroup <U, D, R2, L2, F2, B2>,
+  // where twist, flip and slice are solved. 0 exactly inside it.
+  unsigned
+  phaseOneBound(const CoordState& c) const
+  {
+    unsigned twist = m_twistSlice[c.twist * SLICE_COUNT + c.slice];
+    unsigned flip = m_flipSlice[c.flip * SLICE_COUNT + c.slice];
+    return flip > twist ? flip : twist;
+  }
+
+  // True if edge slot (and cubie) 'e' belongs to the E slice
+  bool
+  isSliceEdge(unsigned e) const
+  {
+    return m_isSlice[e];
+  }
+
+private:
+  // Positions of the slice edges in the combinatorial number system
+  uint16_t
+  sliceRank(const Cube& cube) const
+  {
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    cube.cubies(cp, co, ep, eo);
+
+    unsigned r = 0, k = 0;
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+      if (m_isSlice[ep[s]])
+        r += BINOMIALS.value[s][++k];
+
+    return (uint16_t) r;
+  }
+
+  // A cube whose slice edges sit at the positions ranked 'r'
+  Cube
+  sliceCube(unsigned r) const
+  {
+    bool occupied[EDGE_COUNT] = { };
+    for (unsigned k = SLICE_EDGE_COUNT, s = EDGE_COUNT; k > 0; --k)
+    {
+      while (BINOMIALS.value[--s][k] > r)
+        ;
+      r -= BINOMIALS.value[s][k];
+      occupied[s] = true;
+    }
+
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    Cube().cubies(cp, co, ep, eo);
+
+    unsigned nextSlice = 0, nextOther = 0;
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+    {
+      if (occupied[s])
+        ep[s] = m_sliceEdges[nextSlice++];
+      else
+      {
+        while (m_isSlice[nextOther])
+          ++nextOther;
+        ep[s] = nextOther++;
+      }
+    }
+
+    return Cube::fromCubies(cp, co, ep, eo);
+  }
+
+  template<typename Make, typename Read>
+  static void
+  buildMoves(std::vector<uint16_t>& table, unsigned count, Make make, Read read)
+  {
+    for (unsigned v = 0; v < count; ++v)
+    {
+      Cube cube = make(v);
+      for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+      {
+        Cube child(cube);
+        child.turn(codeFace(code), codeTurns(code));
+        table[v * START_MOVE_COUNT + code] = (uint16_t) read(child);
+      }
+    }
+  }
+
+  // Breadth-first distances from 'start' over 'size' indices
+  template<typename Next>
+  static void
+  buildPruning(std::vector<uint8_t>& table, uint32_t size, uint32_t start, Next next)
+  {
+    table.assign(size, UNVISITED);
+    table[start] = 0;
+
+    std::vector<uint32_t> layer(1, start);
+    for (uint8_t depth = 1; layer.size() > 0; ++depth)
+    {
+      std::vector<uint32_t> following;
+      for (uint32_t i : layer)
+        for (unsigned m = 0; m < START_MOVE_COUNT; ++m)
+        {
+          uint32_t j = next(i, m);
+          if (table[j] == UNVISITED)
+          {
+            table[j] = depth;
+            following.push_back(j);
+          }
+        }
+
+      layer.swap(following);
+    }
+  }
+
+  bool m_isSlice[EDGE_COUNT];
+  std::vector<unsigned> m_sliceEdges;
+  std::vector<uint16_t> m_twistMove;
+  std::vector<uint16_t> m_flipMove;
+  std::vector<uint16_t> m_cornerPermMove;
+  std::vector<uint16_t> m_sliceMove;
+  std::vector<uint8_t> m_twistSlice;
+  std::vector<uint8_t> m_flipSlice;
+  std::vector<uint8_t> m_cornerPerm;
+  CoordState m_solved;
+};
+
+#endif
@@ -24,8 +24,11 @@
 #include <cstdio>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <unordered_map>
 #include <cmath>
+#include <cstdint>
+#include <utility>
 
 /************************************************/
 // Local includes
@@ -35,12 +38,76 @@
 // Typedefs/Macros
 
 typedef int piece_t;
+typedef unsigned __int128 rank_t;
+typedef std::vector<std::string> moveset_t;
 
 #ifndef CUBE_HPP
 #define CUBE_HPP
 
 /************************************************/
 
+// Inverse of CORNER_FACELETS/EDGE_FACELETS: which cubie each facelet belongs
+// to and its index within that cubie's facelet list.
+struct CubieIndex
+{
+  int cubie[PIECE_COUNT];
+  int facelet[PIECE_COUNT];
+};
+
+constexpr CubieIndex
+makeCubieIndex()
+{
+  CubieIndex index {};
+  for (unsigned c = 0; c < CORNER_COUNT; ++c)
+    for (unsigned k = 0; k < 3; ++k)
+    {
+      index.cubie[CORNER_FACELETS[c][k]] = c;
+      index.facelet[CORNER_FACELETS[c][k]] = k;
+    }
+
+  for (unsigned e = 0; e < EDGE_COUNT; ++e)
+    for (unsigned k = 0; k < 2; ++k)
+    {
+      index.cubie[EDGE_FACELETS[e][k]] = e;
+      index.facelet[EDGE_FACELETS[e][k]] = k;
+    }
+
+  return index;
+}
+
+constexpr CubieIndex CUBIE_INDEX = makeCubieIndex();
+
+// Bit counts for every 12-bit mask, and the position of the k-th set bit of
+// every byte, so permutation ranking is branch-free and does not depend on
+// the target having popcount or pdep instructions.
+struct BitTables
+{
+  uint8_t count[1 << EDGE_COUNT];
+  uint8_t select[256][8];
+};
+
+constexpr BitTables
+makeBitTables()
+{
+  BitTables tables {};
+  for (unsigned mask = 1; mask < (1u << EDGE_COUNT); ++mask)
+    tables.count[mask] = tables.count[mask >> 1] + (mask & 1);
+
+  for (unsigned byte = 0; byte < 256; ++byte)
+  {
+    unsigned k = 0;
+    for (unsigned bit = 0; bit < 8; ++bit)
+      if (byte & (1u << bit))
+        tables.select[byte][k++] = bit;
+  }
+
+  return tables;
+}
+
+constexpr BitTables BIT_TABLES = makeBitTables();
+
+/************************************************/
+
 class Cube
 {
 public:
@@ -52,7 +119,7 @@ public:
   }
   
   // copy ctor
-  Cube(const Cube& other)
+  Cube(const Cube& other) noexcept
   {
     for (unsigned i = 0; i < PIECE_COUNT; ++i)
       m_cube[i] = other.m_cube[i];
@@ -82,17 +149,45 @@ public:
       rotateSide(index, false);
   }
 
-  // scramble the cube given a space seperated scramble string
+  // rotate side 'side' (index into MOVE_NAMES) clockwise 'quarterTurns'
+  // times, without parsing a move string
+  void
+  turn(unsigned side, unsigned quarterTurns)
+  {
+    if (quarterTurns % 4 == 3)
+      rotateSide(side, true);
+    else
+      for (unsigned i = 0; i < quarterTurns % 4; ++i)
+        rotateSide(side, false);
+  }
+
+  // scramble the cube given a whitespace seperated scramble string
   void
   scramble(const std::string& moveStr)
   {
     std::stringstream tokenize(moveStr);
     std::string token;
 
-    while (std::getline(tokenize, token, ' '))
+    while (tokenize >> token)
       move(token);
   }
 
+  // True if every move in a scramble string is a face letter, optionally
+  // followed by ' or 2, so scramble() accepts it
+  static bool
+  validScramble(const std::string& moveStr)
+  {
+    std::stringstream tokenize(moveStr);
+    std::string token;
+
+    while (tokenize >> token)
+      if (m_moveMap.count(token[0]) == 0 || token.size() > 2 ||
+          (token.size() == 2 && token[1] != '\'' && token[1] != '2'))
+        return false;
+
+    return true;
+  }
+
   bool
   isSolved()
   {
@@ -125,13 +220,337 @@ public:
     return totalDist / 4;
   }
   
+  // Admissible lower bound on the number of moves left. Every face turn
+  // relocates exactly 20 pieces, so misplaced pieces / 20 (rounded up) never
+  // overestimates.
+  int
+  movesLowerBound() const
+  {
+    return (misplacedCount() + MOVED_PIECE_COUNT - 1) / MOVED_PIECE_COUNT;
+  }
+
+  // Number of pieces not in their solved position
+  int
+  misplacedCount() const
+  {
+    int misplaced = 0;
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+      if ((piece_t) i != m_cube[i])
+        ++misplaced;
+
+    return misplaced;
+  }
+
   bool
   operator<(const Cube& other) const
   {
     return distanceToSolved() < other.distanceToSolved();
   }
 
+  bool
+  operator==(const Cube& other) const
+  {
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+      if (m_cube[i] != other.m_cube[i])
+        return false;
+
+    return true;
+  }
+
+  // FNV-1a over the piece array
+  size_t
+  hash() const
+  {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+    {
+      h ^= (uint64_t) m_cube[i];
+      h *= 1099511628211ULL;
+    }
+
+    return (size_t) h;
+  }
+
+  // Perfect ranks. Sub-coordinates cover any arrangement of their pieces:
+  //   corner permutation [0, 8!)    corner orientation [0, 3^7)
+  //   edge permutation   [0, 12!)   edge orientation   [0, 2^11)
+  // The full rank only covers reachable states, where edge parity follows
+  // corner parity, so it lies in [0, 8! * 3^7 * 12! / 2 * 2^11). That is
+  // about 4.3e19, slightly more than 64 bits hold, hence rank_t.
+  uint64_t
+  cornerPermRank() const
+  {
+    unsigned perm[CORNER_COUNT], orient[CORNER_COUNT];
+    getCorners(perm, orient);
+    return rankPermutation<CORNER_COUNT>(perm);
+  }
+
+  uint64_t
+  cornerOrientRank() const
+  {
+    unsigned perm[CORNER_COUNT], orient[CORNER_COUNT];
+    getCorners(perm, orient);
+    return rankOrientation<CORNER_COUNT, 3>(orient);
+  }
+
+  uint64_t
+  edgePermRank() const
+  {
+    unsigned perm[EDGE_COUNT], orient[EDGE_COUNT];
+    getEdges(perm, orient);
+    return rankPermutation<EDGE_COUNT>(perm);
+  }
+
+  uint64_t
+  edgeOrientRank() const
+  {
+    unsigned perm[EDGE_COUNT], orient[EDGE_COUNT];
+    getEdges(perm, orient);
+    return rankOrientation<EDGE_COUNT, 2>(orient);
+  }
+
+  // Corner permutation and orientation combined, in [0, 8! * 3^7)
+  uint64_t
+  cornerRank() const
+  {
+    unsigned perm[CORNER_COUNT], orient[CORNER_COUNT];
+    getCorners(perm, orient);
+    return rankPermutation<CORNER_COUNT>(perm) * CORNER_ORIENT_COUNT + rankOrientation<CORNER_COUNT, 3>(orient);
+  }
+
+  // Edge permutation and orientation combined, in [0, 12! * 2^11)
+  uint64_t
+  edgeRank() const
+  {
+    unsigned perm[EDGE_COUNT], orient[EDGE_COUNT];
+    getEdges(perm, orient);
+    return rankPermutation<EDGE_COUNT>(perm) * EDGE_ORIENT_COUNT + rankOrientation<EDGE_COUNT, 2>(orient);
+  }
+
+  // Full state. The lowest Lehmer digit of the edge permutation is implied by
+  // corner parity, so only the edge rank divided by two is stored.
+  rank_t
+  rank() const
+  {
+    unsigned edgePerm[EDGE_COUNT], edgeOrient[EDGE_COUNT];
+    getEdges(edgePerm, edgeOrient);
+
+    uint64_t edges = rankPermutation<EDGE_COUNT>(edgePerm) / 2 * EDGE_ORIENT_COUNT +
+                     rankOrientation<EDGE_COUNT, 2>(edgeOrient);
+    return (rank_t) cornerRank() * (EDGE_PERM_COUNT / 2 * EDGE_ORIENT_COUNT) + edges;
+  }
+
+  // Cube with the given corners and solved edges
+  static Cube
+  fromCornerRank(uint64_t r)
+  {
+    unsigned perm[CORNER_COUNT], orient[CORNER_COUNT];
+    unrankOrientation<CORNER_COUNT, 3>(r % CORNER_ORIENT_COUNT, orient);
+    unrankPermutation<CORNER_COUNT>(r / CORNER_ORIENT_COUNT, perm);
+
+    Cube cube;
+    cube.setCorners(perm, orient);
+    return cube;
+  }
+
+  // Cube with the given edges and solved corners
+  static Cube
+  fromEdgeRank(uint64_t r)
+  {
+    unsigned perm[EDGE_COUNT], orient[EDGE_COUNT];
+    unrankOrientation<EDGE_COUNT, 2>(r % EDGE_ORIENT_COUNT, orient);
+    unrankPermutation<EDGE_COUNT>(r / EDGE_ORIENT_COUNT, perm);
+
+    Cube cube;
+    cube.setEdges(perm, orient);
+    return cube;
+  }
+
+  static Cube
+  fromRank(rank_t r)
+  {
+    // One 128-bit division splits the rank so the rest is 64-bit arithmetic
+    const uint64_t edgeStates = EDGE_PERM_COUNT / 2 * EDGE_ORIENT_COUNT;
+    uint64_t corners = (uint64_t) (r / edgeStates);
+    uint64_t edges = (uint64_t) (r % edgeStates);
+
+    unsigned cornerPerm[CORNER_COUNT], cornerOrient[CORNER_COUNT];
+    unrankOrientation<CORNER_COUNT, 3>(corners % CORNER_ORIENT_COUNT, cornerOrient);
+    unrankPermutation<CORNER_COUNT>(corners / CORNER_ORIENT_COUNT, cornerPerm);
+
+    unsigned edgePerm[EDGE_COUNT], edgeOrient[EDGE_COUNT];
+    unrankOrientation<EDGE_COUNT, 2>(edges % EDGE_ORIENT_COUNT, edgeOrient);
+    unrankPermutation<EDGE_COUNT>(edges / EDGE_ORIENT_COUNT * 2, edgePerm);
+
+    // The dropped lowest Lehmer digit orders the last two edges. Setting it
+    // swaps them, which fixes the parity.
+    if (permutationParity<EDGE_COUNT>(edgePerm) != permutationParity<CORNER_COUNT>(cornerPerm))
+      std::swap(edgePerm[EDGE_COUNT - 2], edgePerm[EDGE_COUNT - 1]);
+
+    Cube cube;
+    cube.setCorners(cornerPerm, cornerOrient);
+    cube.setEdges(edgePerm, edgeOrient);
+    return cube;
+  }
+
+  // Cubie-level view. Corner slot s holds cubie cornerPerm[s] with its U/D
+  // facelet on slot facelet cornerOrient[s], and likewise for edges.
+  void
+  cubies(unsigned cornerPerm[CORNER_COUNT], unsigned cornerOrient[CORNER_COUNT],
+         unsigned edgePerm[EDGE_COUNT], unsigned edgeOrient[EDGE_COUNT]) const
+  {
+    getCorners(cornerPerm, cornerOrient);
+    getEdges(edgePerm, edgeOrient);
+  }
+
+  // Inverse of cubies(). The caller is responsible for parity and
+  // orientation sums if the result must be reachable.
+  static Cube
+  fromCubies(const unsigned cornerPerm[CORNER_COUNT], const unsigned cornerOrient[CORNER_COUNT],
+             const unsigned edgePerm[EDGE_COUNT], const unsigned edgeOrient[EDGE_COUNT])
+  {
+    Cube cube;
+    cube.setCorners(cornerPerm, cornerOrient);
+    cube.setEdges(edgePerm, edgeOrient);
+    return cube;
+  }
+
+  // 0 for an even permutation of N pieces, 1 for odd
+  template<unsigned N>
+  static unsigned
+  permutationParity(const unsigned perm[N])
+  {
+    unsigned parity = 0;
+    unsigned used = 0;
+    for (unsigned i = 0; i < N; ++i)
+    {
+      parity += perm[i] - BIT_TABLES.count[used & ((1u << perm[i]) - 1)];
+      used |= 1u << perm[i];
+    }
+
+    return parity & 1;
+  }
+
 private:
+  // Loads and stores facelets directly
+  friend class CubeBatch;
+
+  // Cubie in each corner slot and the slot facelet holding its U/D facelet.
+  // Slot facelet k holds cubie facelet (k - orient) mod 3, so the piece in
+  // slot facelet 0 is enough to recover both.
+  void
+  getCorners(unsigned perm[CORNER_COUNT], unsigned orient[CORNER_COUNT]) const
+  {
+    for (unsigned s = 0; s < CORNER_COUNT; ++s)
+    {
+      piece_t piece = m_cube[CORNER_FACELETS[s][0]];
+      perm[s] = CUBIE_INDEX.cubie[piece];
+      orient[s] = (3 - CUBIE_INDEX.facelet[piece]) % 3;
+    }
+  }
+
+  void
+  getEdges(unsigned perm[EDGE_COUNT], unsigned orient[EDGE_COUNT]) const
+  {
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+    {
+      piece_t piece = m_cube[EDGE_FACELETS[s][0]];
+      perm[s] = CUBIE_INDEX.cubie[piece];
+      orient[s] = CUBIE_INDEX.facelet[piece];
+    }
+  }
+
+  void
+  setCorners(const unsigned perm[CORNER_COUNT], const unsigned orient[CORNER_COUNT])
+  {
+    for (unsigned s = 0; s < CORNER_COUNT; ++s)
+      for (unsigned k = 0; k < 3; ++k)
+        m_cube[CORNER_FACELETS[s][k]] = CORNER_FACELETS[perm[s]][(k + 3 - orient[s]) % 3];
+  }
+
+  void
+  setEdges(const unsigned perm[EDGE_COUNT], const unsigned orient[EDGE_COUNT])
+  {
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+      for (unsigned k = 0; k < 2; ++k)
+        m_cube[EDGE_FACELETS[s][k]] = EDGE_FACELETS[perm[s]][k ^ orient[s]];
+  }
+
+  // Lehmer code in the factorial number system. Each digit counts the
+  // smaller elements not used yet, found with one bit count over a mask of
+  // the elements already placed.
+  template<unsigned N>
+  static uint64_t
+  rankPermutation(const unsigned perm[N])
+  {
+    uint64_t r = 0;
+    unsigned used = 0;
+    for (unsigned i = 0; i < N; ++i)
+    {
+      unsigned below = (1u << perm[i]) - 1;
+      r = r * (N - i) + perm[i] - BIT_TABLES.count[used & below];
+      used |= 1u << perm[i];
+    }
+
+    return r;
+  }
+
+  template<unsigned N>
+  static void
+  unrankPermutation(uint64_t r, unsigned perm[N])
+  {
+    // 12! fits in 32 bits. Unrolling turns every divisor into a constant the
+    // compiler can replace with a multiply.
+    uint32_t rest = (uint32_t) r;
+    unsigned digits[N];
+#pragma GCC unroll 16
+    for (unsigned base = 1; base <= N; ++base)
+    {
+      digits[N - base] = rest % base;
+      rest /= base;
+    }
+
+    // Select the digit-th free element, from the low byte of the free mask
+    // if it has enough set bits, otherwise from the high bits
+    unsigned free = (1u << N) - 1;
+    for (unsigned i = 0; i < N; ++i)
+    {
+      unsigned low = free & 0xFF;
+      unsigned lowCount = BIT_TABLES.count[low];
+      perm[i] = digits[i] < lowCount ? BIT_TABLES.select[low][digits[i]]
+                                     : 8 + BIT_TABLES.select[free >> 8][digits[i] - lowCount];
+      free &= ~(1u << perm[i]);
+    }
+  }
+
+  // Base-K digits of the first N - 1 pieces. The last piece is implied by
+  // the sum of all orientations being 0 mod K.
+  template<unsigned N, unsigned K>
+  static uint64_t
+  rankOrientation(const unsigned orient[N])
+  {
+    uint64_t r = 0;
+    for (unsigned i = 0; i < N - 1; ++i)
+      r = r * K + orient[i];
+
+    return r;
+  }
+
+  template<unsigned N, unsigned K>
+  static void
+  unrankOrientation(uint64_t r, unsigned orient[N])
+  {
+    unsigned sum = 0;
+    for (unsigned i = N - 1; i-- > 0; )
+    {
+      orient[i] = r % K;
+      sum += orient[i];
+      r /= K;
+    }
+
+    orient[N - 1] = (K - sum % K) % K;
+  }
+
   // Rotate single side 90 degrees
   // If prime is true, rotate counter-clockwise 90 degrees, otherwise clockwise
   void
@@ -141,10 +560,10 @@ private:
     {
       auto cycle = MOVE_CYCLES[sideNum][i];
       piece_t buffer[CYCLE_LENGTH];
+      piece_t revCycle[CYCLE_LENGTH];
 
       if (prime)
       {
-        piece_t revCycle[CYCLE_LENGTH];
         for (unsigned f = 0, b = CYCLE_LENGTH - 1; f < CYCLE_LENGTH; ++f, --b)
           revCycle[f] = cycle[b];
 
@@ -164,4 +583,14 @@ private:
   piece_t m_cube[PIECE_COUNT];
 };
 
+// Hash functor so Cube can key unordered containers
+struct CubeHash
+{
+  size_t
+  operator()(const Cube& cube) const
+  {
+    return cube.hash();
+  }
+};
+
 #endif
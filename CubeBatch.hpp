@@ -0,0 +1,187 @@
+/*
+ * Sean Malloy
+ * CubeBatch.hpp
+ * Many cubes stored structure-of-arrays: facelet i of every cube is one
+ * contiguous row of bytes. Turning a face is then one row copy per facelet
+ * for the whole batch, and the solved check and lower bound are byte-wise
+ * loops over rows.
+ *
+ * The kernels are compiled for AVX-512, AVX2 and baseline x86-64, and the
+ * best one the CPU supports is picked when the program loads, so the build
+ * needs no -m flags.
+ */
+
+#ifndef CUBE_BATCH_HPP
+#define CUBE_BATCH_HPP
+
+/************************************************/
+// System includes
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+
+/************************************************/
+
+// Rows are padded to a multiple of one AVX-512 register
+const size_t BATCH_ROW_ALIGN = 64;
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define BATCH_KERNEL __attribute__((target_clones("arch=x86-64-v4", "avx2", "default")))
+#else
+#define BATCH_KERNEL
+#endif
+
+/************************************************/
+
+// out[c] = 1 if every row i of cube c holds i
+BATCH_KERNEL inline void
+batchSolvedKernel(const uint8_t* facelets, size_t stride, size_t n, uint8_t* out)
+{
+  for (size_t c = 0; c < n; ++c)
+    out[c] = 0;
+
+  for (unsigned i = 0; i < PIECE_COUNT; ++i)
+  {
+    const uint8_t* row = facelets + i * stride;
+    for (size_t c = 0; c < n; ++c)
+      out[c] |= row[c] ^ (uint8_t) i;
+  }
+
+  for (size_t c = 0; c < n; ++c)
+    out[c] = out[c] == 0;
+}
+
+// out[c] = Cube::movesLowerBound() of cube c. At most PIECE_COUNT facelets
+// are misplaced, so the rounded-up quotient is a sum of three comparisons.
+BATCH_KERNEL inline void
+batchLowerBoundKernel(const uint8_t* facelets, size_t stride, size_t n, uint8_t* out)
+{
+  for (size_t c = 0; c < n; ++c)
+    out[c] = 0;
+
+  for (unsigned i = 0; i < PIECE_COUNT; ++i)
+  {
+    const uint8_t* row = facelets + i * stride;
+    for (size_t c = 0; c < n; ++c)
+      out[c] += row[c] != (uint8_t) i;
+  }
+
+  static_assert(PIECE_COUNT <= 3 * MOVED_PIECE_COUNT, "bound needs more terms");
+  for (size_t c = 0; c < n; ++c)
+    out[c] = (out[c] > 0) + (out[c] > MOVED_PIECE_COUNT) + (out[c] > 2 * MOVED_PIECE_COUNT);
+}
+
+/************************************************/
+
+class CubeBatch
+{
+public:
+  explicit CubeBatch(size_t capacity)
+    : m_stride((capacity + BATCH_ROW_ALIGN - 1) / BATCH_ROW_ALIGN * BATCH_ROW_ALIGN),
+      m_size(0),
+      m_facelets(PIECE_COUNT * m_stride)
+  { }
+
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+
+  size_t
+  capacity() const
+  {
+    return m_stride;
+  }
+
+  void
+  clear()
+  {
+    m_size = 0;
+  }
+
+  // Appends 'cube'. The caller keeps size() below capacity().
+  void
+  push(const Cube& cube)
+  {
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+      m_facelets[i * m_stride + m_size] = (uint8_t) cube.m_cube[i];
+    ++m_size;
+  }
+
+  Cube
+  get(size_t c) const
+  {
+    Cube cube;
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+      cube.m_cube[i] = m_facelets[i * m_stride + c];
+
+    return cube;
+  }
+
+  // Replaces this batch with every cube of 'src' after turning 'side'
+  // clockwise 'quarterTurns' times
+  void
+  assignTurned(const CubeBatch& src, unsigned side, unsigned quarterTurns)
+  {
+    const uint8_t* sources = moveSources()[side][quarterTurns % 4];
+    for (unsigned i = 0; i < PIECE_COUNT; ++i)
+      memcpy(&m_facelets[i * m_stride], &src.m_facelets[sources[i] * src.m_stride], src.m_size);
+
+    m_size = src.m_size;
+  }
+
+  // out[c] = 1 if cube c is solved
+  void
+  solvedMask(uint8_t* out) const
+  {
+    batchSolvedKernel(m_facelets.data(), m_stride, m_size, out);
+  }
+
+  // out[c] = Cube::movesLowerBound() of cube c
+  void
+  lowerBounds(uint8_t* out) const
+  {
+    batchLowerBoundKernel(m_facelets.data(), m_stride, m_size, out);
+  }
+
+private:
+  typedef uint8_t moveSources_t[SIDE_COUNT][4][PIECE_COUNT];
+
+  // After turning side s clockwise q times, facelet i holds what was at
+  // moveSources()[s][q][i]. Read off turned solved cubes once.
+  static const moveSources_t&
+  moveSources()
+  {
+    struct Table
+    {
+      Table()
+      {
+        for (unsigned s = 0; s < SIDE_COUNT; ++s)
+          for (unsigned q = 0; q < 4; ++q)
+          {
+            Cube cube;
+            cube.turn(s, q);
+            for (unsigned i = 0; i < PIECE_COUNT; ++i)
+              sources[s][q][i] = (uint8_t) cube.m_cube[i];
+          }
+      }
+
+      moveSources_t sources;
+    };
+
+    static const Table table;
+    return table.sources;
+  }
+
+  size_t m_stride;
+  size_t m_size;
+  std::vector<uint8_t> m_facelets;
+};
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * Sean Malloy
+ * Enumerator.hpp
+ * Pull-based enumeration of every optimal solution. The final iterative
+ * deepening iteration runs as a resumable depth-first search with an
+ * explicit stack, so each call to next() picks up where the last solution
+ * was found and memory stays proportional to the solution length.
+ *
+ * Each frame carries the state as coordinates (see Coordinates.hpp), so a
+ * node costs a few table loads; the cube itself is only rebuilt from the
+ * root to verify a leaf whose coordinates are all solved.
+ *
+ * Solutions are canonical: no face is turned twice in a row and turns of
+ * opposite faces, which commute, appear in MOVE_NAMES order only. So "U D"
+ * is produced but "D U" is not; Solver::enumerateOptimal() can expand the
+ * other orderings.
+ */
+
+#ifndef ENUMERATOR_HPP
+#define ENUMERATOR_HPP
+
+/************************************************/
+// System includes
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Coordinates.hpp"
+#include "Peephole.hpp"
+#include "PerfCounters.hpp"
+#include "ThreadPool.hpp"
+
+/************************************************/
+
+const size_t MAX_SOLUTION_DEPTH = 20;
+const size_t ENUMERATOR_QUEUE_SIZE = 64;
+
+// Resumable search over solutions of exactly one length. Until a depth is
+// fixed, next() deepens from the cube's lower bound and the first solution
+// found fixes it.
+class OptimalEnumerator
+{
+  struct Frame
+  {
+    CoordState coords;
+    uint8_t next;
+    uint8_t move;
+  };
+
+public:
+  // Enumerates every optimal solution of 'cube'
+  explicit OptimalEnumerator(const Cube& cube)
+    : m_tables(CoordTables::instance()),
+      m_root(cube),
+      m_rootCoords(m_tables.fromCube(cube)),
+      m_depth(0),
+      m_depthKnown(false),
+      m_rootPending(false),
+      m_firstMoves(START_MOVE_COUNT, true),
+      m_stack(),
+      m_stop(nullptr)
+  { }
+
+  // Enumerates solutions of exactly 'depth' moves whose first move is one
+  // of 'firstMoves' (move codes, see Peephole.hpp)
+  OptimalEnumerator(const Cube& cube, size_t depth, const movecode_t& firstMoves)
+    : m_tables(CoordTables::instance()),
+      m_root(cube),
+      m_rootCoords(m_tables.fromCube(cube)),
+      m_depth(depth),
+      m_depthKnown(true),
+      m_rootPending(false),
+      m_firstMoves(START_MOVE_COUNT, false),
+      m_stack(),
+      m_stop(nullptr)
+  {
+    for (uint8_t code : firstMoves)
+      m_firstMoves[code] = true;
+
+    reset();
+  }
+
+  // Produces the next solution. Returns false once every solution has been
+  // produced.
+  bool
+  next(moveset_t& solution)
+  {
+    if (m_depthKnown)
+      return advance(solution);
+
+    m_depthKnown = true;
+    m_depth = std::max((unsigned) m_root.movesLowerBound(), m_tables.lowerBound(m_rootCoords));
+    for (; m_depth <= MAX_SOLUTION_DEPTH; ++m_depth)
+    {
+      reset();
+      if (advance(solution))
+        return true;
+    }
+
+    return false;
+  }
+
+  // next() gives up and returns false once 'stop' is set
+  void
+  setStopFlag(const std::atomic<bool>* stop)
+  {
+    m_stop = stop;
+  }
+
+  // Solution length, valid once next() has returned a solution or if given
+  // to the constructor
+  size_t
+  depth() const
+  {
+    return m_depth;
+  }
+
+private:
+  void
+  reset()
+  {
+    m_stack.clear();
+    m_stack.reserve(m_depth + 1);
+    m_stack.push_back({ m_rootCoords, 0, 0 });
+    m_rootPending = m_depth == 0;
+  }
+
+  bool
+  allowed(uint8_t code, size_t g) const
+  {
+    if (g == 0)
+      return m_firstMoves[code];
+
+    unsigned face = codeFace(code);
+    unsigned prev = codeFace(m_stack.back().move);
+    return face != prev && !(prev == oppositeFaceIndex(face) && face < prev);
+  }
+
+  bool
+  advance(moveset_t& solution)
+  {
+    // A solved root has exactly one solution, the empty one
+    if (m_depth == 0)
+    {
+      bool found = m_rootPending && m_root.isSolved();
+      m_rootPending = false;
+      if (found)
+        solution.clear();
+      return found;
+    }
+
+    while (m_stack.size() > 0)
+    {
+      if (m_stop != nullptr && m_stop->load(std::memory_order_relaxed))
+        return false;
+
+      Frame& top = m_stack.back();
+      size_t g = m_stack.size() - 1;
+      if (top.next >= START_MOVE_COUNT)
+      {
+        m_stack.pop_back();
+        continue;
+      }
+
+      // A frame is expanded when its first child is generated
+      if (top.next == 0)
+        ++t_expandedNodes;
+
+      uint8_t code = top.next++;
+      if (!allowed(code, g))
+        continue;
+
+      CoordState child = m_tables.move(top.coords, code);
+      unsigned h = m_tables.lowerBound(child);
+      if (g + 1 + h > m_depth)
+        continue;
+
+      if (g + 1 == m_depth)
+      {
+        // The coordinates leave edge permutation out, so check the cube
+        movecode_t codes;
+        for (size_t i = 1; i < m_stack.size(); ++i)
+          codes.push_back(m_stack[i].move);
+        codes.push_back(code);
+
+        Cube cube(m_root);
+        for (uint8_t c : codes)
+          cube.turn(codeFace(c), codeTurns(c));
+        if (!cube.isSolved())
+          continue;
+
+        solution = decodeMoves(codes);
+        return true;
+      }
+
+      m_stack.push_back({ child, 0, code });
+    }
+
+    return false;
+  }
+
+  const CoordTables& m_tables;
+  Cube m_root;
+  CoordState m_rootCoords;
+  size_t m_depth;
+  bool m_depthKnown;
+  bool m_rootPending;
+  std::vector<bool> m_firstMoves;
+  std::vector<Frame> m_stack;
+  const std::atomic<bool>* m_stop;
+};
+
+/************************************************/
+
+// Runs every iteration of the deepening across a gang of 'p' workers from
+// 'pool', split by first move, and merges their solutions through a bounded
+// queue, so workers pause while the consumer is not pulling. Workers finish
+// each depth together before any starts the next, so every solution found is
+// optimal and the first depth with one is the last searched. Destroying the
+// enumerator stops the workers early.
+class ParallelOptimalEnumerator
+{
+public:
+  ParallelOptimalEnumerator(const Cube& cube, unsigned p, ThreadPool& pool)
+    : m_queue(),
+      m_lock(),
+      m_notEmpty(),
+      m_notFull(),
+      m_depthDone(),
+      m_running(0),
+      m_arrived(0),
+      m_generation(0),
+      m_found(false),
+      m_depthFound(false),
+      m_stop(false),
+      m_done()
+  {
+    // The empty solution of a solved cube has no first move to split on
+    if (cube.isSolved())
+    {
+      m_queue.push_back(moveset_t());
+      return;
+    }
+
+    if (p == 0)
+      p = 1;
+
+    const CoordTables& tables = CoordTables::instance();
+    size_t minDepth = std::max((unsigned) cube.movesLowerBound(), tables.lowerBound(tables.fromCube(cube)));
+
+    m_running = p;
+    m_done = pool.runGang(p, [this, cube, minDepth, p](unsigned tid)
+    {
+      movecode_t firstMoves;
+      for (unsigned m = START_MOVE_COUNT * tid / p; m < START_MOVE_COUNT * (tid + 1) / p; ++m)
+        firstMoves.push_back(m);
+
+      worker(cube, std::max((size_t) 1, minDepth), firstMoves, tid);
+    });
+  }
+
+  ParallelOptimalEnumerator(const ParallelOptimalEnumerator&) = delete;
+  ParallelOptimalEnumerator& operator=(const ParallelOptimalEnumerator&) = delete;
+
+  ~ParallelOptimalEnumerator()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop.store(true);
+    }
+    m_notFull.notify_all();
+    m_depthDone.notify_all();
+
+    if (m_done.valid())
+      m_done.wait();
+  }
+
+  // Blocks until some worker produces a solution. Returns false once every
+  // worker has finished and the queue is drained.
+  bool
+  next(moveset_t& solution)
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_notEmpty.wait(guard, [this] { return m_queue.size() > 0 || m_running == 0; });
+    if (m_queue.size() == 0)
+      return false;
+
+    solution = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_notFull.notify_one();
+    return true;
+  }
+
+private:
+  void
+  worker(const Cube& cube, size_t minDepth, const movecode_t& firstMoves, unsigned tid)
+  {
+    PerfScope scope("all", tid);
+    for (size_t depth = minDepth; depth <= MAX_SOLUTION_DEPTH && !m_stop.load(); ++depth)
+    {
+      OptimalEnumerator enumerator(cube, depth, firstMoves);
+      enumerator.setStopFlag(&m_stop);
+
+      moveset_t solution;
+      while (enumerator.next(solution))
+      {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_notFull.wait(guard, [this] { return m_queue.size() < ENUMERATOR_QUEUE_SIZE || m_stop.load(); });
+        if (m_stop.load())
+          break;
+
+        m_queue.push_back(solution);
+        m_found = true;
+        m_notEmpty.notify_one();
+      }
+
+      if (finishDepth())
+        break;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    --m_running;
+    m_notEmpty.notify_all();
+  }
+
+  // Waits until every worker has finished the current depth. Returns true if
+  // any of them found a solution at it. The last worker to arrive records
+  // the answer, so a worker already past the barrier cannot change it.
+  bool
+  finishDepth()
+  {
+    std::unique_lock<std::mutex> guard(m_lock);
+    size_t generation = m_generation;
+    if (++m_arrived == m_running)
+    {
+      m_arrived = 0;
+      m_depthFound = m_found;
+      ++m_generation;
+      m_depthDone.notify_all();
+    }
+    else
+      m_depthDone.wait(guard, [this, generation] { return m_generation != generation || m_stop.load(); });
+
+    return m_depthFound || m_stop.load();
+  }
+
+  std::deque<moveset_t> m_queue;
+  std::mutex m_lock;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+  std::condition_variable m_depthDone;
+  unsigned m_running;
+  unsigned m_arrived;
+  size_t m_generation;
+  bool m_found;
+  bool m_depthFound;
+  std::atomic<bool> m_stop;
+  std::future<void> m_done;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Sean Malloy
+ * MemoryBudget.hpp
+ * Process-wide heap accounting with an optional cap. MemoryHooks.cpp
+ * replaces the global operator new and delete to report every allocation
+ * here, so frontiers, closed tables, batches and lookup tables are all
+ * counted. Programs that do not link it never reach the cap.
+ *
+ * The cap is soft. Allocations never fail because of it; memory-hungry
+ * searches poll overBudget(), or hasRoom() before a large allocation, and
+ * hand over to a bounded-memory search instead of growing until the process
+ * is killed.
+ */
+
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+/************************************************/
+// System includes
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+/************************************************/
+
+class MemoryGovernor
+{
+public:
+  // Constant-initialized, so it is usable by allocations made before main
+  static MemoryGovernor&
+  instance()
+  {
+    static MemoryGovernor governor;
+    return governor;
+  }
+
+  MemoryGovernor(const MemoryGovernor&) = delete;
+  MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+  // 0 removes the cap
+  void
+  setLimit(size_t bytes)
+  {
+    m_limit.store(bytes, std::memory_order_relaxed);
+  }
+
+  size_t
+  limit() const
+  {
+    return m_limit.load(std::memory_order_relaxed);
+  }
+
+  void
+  allocated(size_t bytes)
+  {
+    size_t now = m_current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = m_peak.load(std::memory_order_relaxed);
+    while (now > peak && !m_peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+      ;
+  }
+
+  void
+  freed(size_t bytes)
+  {
+    m_current.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  // True while heap usage is above the cap
+  bool
+  overBudget() const
+  {
+    size_t cap = limit();
+    return cap > 0 && m_current.load(std::memory_order_relaxed) > cap;
+  }
+
+  // True if 'bytes' more can be allocated without going over the cap
+  bool
+  hasRoom(size_t bytes) const
+  {
+    size_t cap = limit();
+    return cap == 0 || m_current.load(std::memory_order_relaxed) + bytes <= cap;
+  }
+
+  size_t
+  current() const
+  {
+    return m_current.load(std::memory_order_relaxed);
+  }
+
+  size_t
+  peak() const
+  {
+    return m_peak.load(std::memory_order_relaxed);
+  }
+
+  // Parses a byte count with an optional K, M or G suffix (powers of 1024).
+  // Returns 0 for malformed input.
+  static size_t
+  parseSize(const std::string& text)
+  {
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    if (end == text.c_str())
+      return 0;
+
+    std::string suffix(end);
+    if (suffix.size() > 0 && toupper(suffix[0]) == 'K')
+      value <<= 10;
+    else if (suffix.size() > 0 && toupper(suffix[0]) == 'M')
+      value <<= 20;
+    else if (suffix.size() > 0 && toupper(suffix[0]) == 'G')
+      value <<= 30;
+    else if (suffix.size() > 0)
+      return 0;
+
+    return (size_t) value;
+  }
+
+private:
+  constexpr MemoryGovernor()
+    : m_current(0),
+      m_peak(0),
+      m_limit(0)
+  { }
+
+  std::atomic<size_t> m_current;
+  std::atomic<size_t> m_peak;
+  std::atomic<size_t> m_limit;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * Sean Malloy
+ * MemoryHooks.cpp
+ * Replacement global operator new and delete that report every allocation
+ * to MemoryGovernor (MemoryBudget.hpp). Linked into the driver only, so
+ * programs embedding libcubesolver.a keep their own allocator. Without
+ * these hooks the memory cap never triggers.
+ */
+/************************************************/
+// System includes
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+/************************************************/
+// Local includes
+#include "MemoryBudget.hpp"
+
+/************************************************/
+// Heap accounting. Every global allocation is reported to MemoryGovernor by
+// its usable size, which is also what the matching delete reports back.
+
+void*
+operator new(size_t size)
+{
+  void* ptr = malloc(size > 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+
+  MemoryGovernor::instance().allocated(malloc_usable_size(ptr));
+  return ptr;
+}
+
+void*
+operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void*
+operator new(size_t size, std::align_val_t align)
+{
+  size_t alignment = (size_t) align;
+  void* ptr = aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+
+  MemoryGovernor::instance().allocated(malloc_usable_size(ptr));
+  return ptr;
+}
+
+void*
+operator new[](size_t size, std::align_val_t align)
+{
+  return operator new(size, align);
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  if (ptr == nullptr)
+    return;
+
+  MemoryGovernor::instance().freed(malloc_usable_size(ptr));
+  free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete(void* ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete[](void* ptr, size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+  operator delete(ptr);
+}
+
+void
+operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+  operator delete(ptr);
+}
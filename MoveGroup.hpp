@@ -0,0 +1,660 @@
+/*
+ * Sean Malloy
+ * MoveGroup.hpp
+ * Optimal solving within a subgroup generated by a fixed set of moves, such
+ * as <R,U>, <R,U,F> or half turns only. The move set is a template
+ * parameter (a mask of move codes, see Peephole.hpp), so each group gets its
+ * move list and its canonical move automaton at compile time and searches
+ * with a branching factor of 3 to 6 instead of about 13.
+ *
+ * Each group also has its own lookup tables. Pieces the group never moves
+ * stay solved. The corners and edges it does move are tracked by
+ * coordinates, projections of the state small enough to enumerate: where
+ * the pieces are, and how the pieces in the moved slots are oriented. Every
+ * value of a coordinate the group can reach gets a dense index, with an
+ * index x move table and the exact distance within the group, found by
+ * breadth-first search. Pruning tables then give the exact distance of
+ * each permutation and orientation pair, or where that pair has too many
+ * values, of the orientation paired with the positions of a subset of the
+ * pieces. The bound is the largest of these, exact at 0 since every moved
+ * piece is covered, and the tables decide membership in the group.
+ */
+
+#ifndef MOVE_GROUP_HPP
+#define MOVE_GROUP_HPP
+
+/************************************************/
+// System includes
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Peephole.hpp"
+#include "PerfCounters.hpp"
+
+/************************************************/
+
+// Move code mask of every turn of 'faces', or of their half turns only
+constexpr uint32_t
+groupMoves(const char* faces, bool halfTurnsOnly = false)
+{
+  uint32_t mask = 0;
+  for (; *faces != '\0'; ++faces)
+    for (unsigned f = 0; f < SIDE_COUNT; ++f)
+      if (MOVE_NAMES[f] == *faces)
+        for (unsigned turns = 1; turns <= 3; ++turns)
+          if (!halfTurnsOnly || turns == 2)
+            mask |= 1u << (f * 3 + turns - 1);
+
+  return mask;
+}
+
+constexpr uint32_t GROUP_RU   = groupMoves("RU");
+constexpr uint32_t GROUP_RUF  = groupMoves("RUF");
+constexpr uint32_t GROUP_HALF = groupMoves(MOVE_NAMES, true);
+
+// Largest coordinate and largest pruning table (one byte per entry)
+const size_t GROUP_COORD_CAP   = 1 << 20;
+const size_t GROUP_PRUNING_CAP = 1 << 24;
+const size_t MAX_GROUP_COORDS  = 8;
+const size_t MAX_GROUP_DEPTH   = 40;
+
+const uint8_t GROUP_UNREACHED = 0xFF;
+
+/************************************************/
+
+// Where each move sends the piece in each slot and how much it twists or
+// flips it, read off turned solved cubes. The slot facelets are listed in
+// a consistent cyclic order, so orientations add up modulo 3 or 2.
+struct PieceMoves
+{
+  PieceMoves()
+  {
+    for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+    {
+      Cube cube;
+      cube.turn(codeFace(code), codeTurns(code));
+
+      unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+      cube.cubies(cp, co, ep, eo);
+      for (unsigned s = 0; s < CORNER_COUNT; ++s)
+      {
+        corners.dest[code][cp[s]] = s;
+        corners.delta[code][cp[s]] = co[s];
+      }
+      for (unsigned s = 0; s < EDGE_COUNT; ++s)
+      {
+        edges.dest[code][ep[s]] = s;
+        edges.delta[code][ep[s]] = eo[s];
+      }
+    }
+  }
+
+  struct Kind
+  {
+    uint8_t dest[START_MOVE_COUNT][EDGE_COUNT];
+    uint8_t delta[START_MOVE_COUNT][EDGE_COUNT];
+  };
+
+  Kind corners;
+  Kind edges;
+};
+
+// Reachable values of a coordinate of some corners or some edges, indexed
+// in breadth-first order so index 0 is solved. With 'slots' set, a state is keyed by the slot
+// (4 bits) of each tracked piece, followed by its orientation (2 bits for
+// corners, 1 for edges) if 'orients' is also set. With 'orients' alone,
+// 'pieces' lists slots and a state is keyed by the orientation of whatever
+// piece sits in each of them.
+struct GroupProjection
+{
+  bool corners;
+  bool slots;
+  bool orients;
+  std::vector<unsigned> pieces;
+  std::vector<std::pair<uint64_t, uint32_t>> index;   // key -> index, sorted
+  std::vector<uint32_t> moves;                        // index * move count + move
+  std::vector<uint8_t> distance;
+
+  // Bits per tracked piece, and the shift of its orientation within them
+  unsigned
+  bits() const
+  {
+    return orientShift() + (orients ? (corners ? 2 : 1) : 0);
+  }
+
+  unsigned
+  orientShift() const
+  {
+    return slots ? 4 : 0;
+  }
+
+  uint32_t
+  size() const
+  {
+    return distance.size();
+  }
+
+  // Index of 'key', or size() if the group cannot reach it
+  uint32_t
+  find(uint64_t key) const
+  {
+    auto it = std::lower_bound(index.begin(), index.end(), std::make_pair(key, (uint32_t) 0));
+    return it != index.end() && it->first == key ? it->second : size();
+  }
+};
+
+// Exact distances within the group of pairs of coordinate values, indexed
+// by first * secondSize + second. GROUP_UNREACHED marks pairs the group
+// cannot reach.
+struct GroupPruning
+{
+  unsigned first;
+  unsigned second;
+  uint32_t secondSize;
+  std::vector<uint8_t> distance;
+};
+
+// Open-addressing map from projection keys to indices, used while building.
+// Keys use at most 60 bits, so an all-ones key marks an empty slot.
+class KeyIndex
+{
+public:
+  KeyIndex()
+    : m_keys(1024, EMPTY),
+      m_values(1024),
+      m_size(0)
+  { }
+
+  // Index of 'key', inserting 'value' first if it is new. 'inserted' tells
+  // which happened.
+  uint32_t
+  emplace(uint64_t key, uint32_t value, bool& inserted)
+  {
+    if (2 * (m_size + 1) > m_keys.size())
+      grow();
+
+    size_t i = slot(key);
+    inserted = m_keys[i] == EMPTY;
+    if (inserted)
+    {
+      m_keys[i] = key;
+      m_values[i] = value;
+      ++m_size;
+    }
+
+    return m_values[i];
+  }
+
+  // Every (key, index) pair, sorted by key
+  std::vector<std::pair<uint64_t, uint32_t>>
+  sorted() const
+  {
+    std::vector<std::pair<uint64_t, uint32_t>> pairs;
+    pairs.reserve(m_size);
+    for (size_t i = 0; i < m_keys.size(); ++i)
+      if (m_keys[i] != EMPTY)
+        pairs.emplace_back(m_keys[i], m_values[i]);
+
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+  }
+
+private:
+  static const uint64_t EMPTY = UINT64_MAX;
+
+  // Position of 'key', or of the empty slot it would go in
+  size_t
+  slot(uint64_t key) const
+  {
+    size_t mask = m_keys.size() - 1;
+    size_t i = (key * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+    while (m_keys[i] != EMPTY && m_keys[i] != key)
+      i = (i + 1) & mask;
+
+    return i;
+  }
+
+  void
+  grow()
+  {
+    std::vector<uint64_t> keys(m_keys.size() * 2, EMPTY);
+    std::vector<uint32_t> values(keys.size());
+    keys.swap(m_keys);
+    values.swap(m_values);
+
+    for (size_t i = 0; i < keys.size(); ++i)
+      if (keys[i] != EMPTY)
+      {
+        size_t j = slot(keys[i]);
+        m_keys[j] = keys[i];
+        m_values[j] = values[i];
+      }
+  }
+
+  std::vector<uint64_t> m_keys;
+  std::vector<uint32_t> m_values;
+  size_t m_size;
+};
+
+/************************************************/
+
+// The move codes in MOVES, in increasing order
+template<uint32_t MOVES>
+constexpr std::array<uint8_t, __builtin_popcount(MOVES)>
+groupCodes()
+{
+  std::array<uint8_t, __builtin_popcount(MOVES)> codes {};
+  unsigned i = 0;
+  for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+    if (MOVES & (1u << code))
+      codes[i++] = code;
+
+  return codes;
+}
+
+// Bit i of entry f is set if move i of groupCodes() may follow a turn of
+// face f, or start the sequence for f = SIDE_COUNT. As in OptimalEnumerator,
+// a face is never turned twice in a row and commuting opposite faces only
+// appear in MOVE_NAMES order.
+template<uint32_t MOVES>
+constexpr std::array<uint32_t, SIDE_COUNT + 1>
+groupAutomaton()
+{
+  constexpr auto codes = groupCodes<MOVES>();
+  std::array<uint32_t, SIDE_COUNT + 1> allowed {};
+  for (unsigned prev = 0; prev <= SIDE_COUNT; ++prev)
+    for (unsigned i = 0; i < codes.size(); ++i)
+    {
+      unsigned face = codes[i] / 3;
+      bool opposite = prev < SIDE_COUNT && OPP_MOVE_NAMES[face] == MOVE_NAMES[prev];
+      if (face != prev && !(opposite && face < prev))
+        allowed[prev] |= 1u << i;
+    }
+
+  return allowed;
+}
+
+/************************************************/
+
+template<uint32_t MOVES>
+class GroupSolver
+{
+  static constexpr unsigned MOVE_COUNT = __builtin_popcount(MOVES);
+  static constexpr auto CODES = groupCodes<MOVES>();
+  static constexpr auto ALLOWED = groupAutomaton<MOVES>();
+
+  typedef std::array<uint32_t, MAX_GROUP_COORDS> state_t;
+
+public:
+  // Tables for this group, built on first use
+  static const GroupSolver&
+  instance()
+  {
+    static GroupSolver solver;
+    return solver;
+  }
+
+  GroupSolver(const GroupSolver&) = delete;
+  GroupSolver& operator=(const GroupSolver&) = delete;
+
+  // True if the moves of this group can solve 'cube'
+  bool
+  contains(const Cube& cube) const
+  {
+    state_t state;
+    return project(cube, state);
+  }
+
+  // Sets 'solution' to the shortest solution of 'cube' using this group's
+  // moves only, which may be longer than its shortest unrestricted solution.
+  // Returns false if the group does not contain 'cube' or no solution has
+  // at most MAX_GROUP_DEPTH moves.
+  bool
+  solve(const Cube& cube, moveset_t& solution) const
+  {
+    state_t root;
+    if (!project(cube, root))
+      return false;
+
+    uint8_t path[MAX_GROUP_DEPTH];
+    for (size_t depth = bound(root); depth <= MAX_GROUP_DEPTH; ++depth)
+    {
+      PerfScope scope("group " + std::to_string(depth));
+      if (depth == 0 || search(root, 0, depth, SIDE_COUNT, path))
+      {
+        solution = decodeMoves(movecode_t(path, path + depth));
+        return true;
+      }
+    }
+
+    // Only if the group's diameter exceeded MAX_GROUP_DEPTH
+    return false;
+  }
+
+  // Entries over all coordinates and pruning tables
+  size_t
+  tableEntries() const
+  {
+    size_t entries = 0;
+    for (const auto& c : m_coords)
+      entries += c.size();
+    for (const auto& p : m_prunings)
+      entries += p.distance.size();
+
+    return entries;
+  }
+
+private:
+  GroupSolver()
+    : m_pieceMoves(),
+      m_cornerMoved(),
+      m_edgeMoved(),
+      m_coords(),
+      m_prunings(),
+      m_standalone()
+  {
+    std::vector<unsigned> corners, edges;
+    for (uint8_t code : CODES)
+    {
+      for (unsigned s = 0; s < CORNER_COUNT; ++s)
+        m_cornerMoved[s] |= m_pieceMoves.corners.dest[code][s] != s || m_pieceMoves.corners.delta[code][s] != 0;
+      for (unsigned s = 0; s < EDGE_COUNT; ++s)
+        m_edgeMoved[s] |= m_pieceMoves.edges.dest[code][s] != s || m_pieceMoves.edges.delta[code][s] != 0;
+    }
+
+    for (unsigned s = 0; s < CORNER_COUNT; ++s)
+      if (m_cornerMoved[s])
+        corners.push_back(s);
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+      if (m_edgeMoved[s])
+        edges.push_back(s);
+
+    addPieces(true, corners);
+    addPieces(false, edges);
+
+    // Coordinates outside every pruning table bound the search on their own
+    for (unsigned j = 0; j < m_coords.size(); ++j)
+      if (std::none_of(m_prunings.begin(), m_prunings.end(),
+                       [j](const GroupPruning& p) { return p.first == j || p.second == j; }))
+        m_standalone.push_back(j);
+  }
+
+  // Tracks the moved 'pieces' of one kind by their permutation and their
+  // orientation, with a pruning table over the pair if it fits under
+  // GROUP_PRUNING_CAP. Otherwise the permutation bounds the search alone,
+  // and the orientation is paired with the positions of the first and of
+  // the last k pieces, for the largest k whose arrangements surely fit.
+  void
+  addPieces(bool corners, const std::vector<unsigned>& pieces)
+  {
+    if (pieces.size() == 0)
+      return;
+
+    unsigned perm = addCoord(makeProjection(corners, true, false, pieces));
+    unsigned orient = addCoord(makeProjection(corners, false, true, pieces));
+    if ((uint64_t) m_coords[perm].size() * m_coords[orient].size() <= GROUP_PRUNING_CAP)
+    {
+      addPruning(perm, orient);
+      return;
+    }
+
+    // Arrangements of k of the n pieces in their n slots
+    size_t k = 0;
+    for (uint64_t arrangements = pieces.size(); k + 1 < pieces.size(); ++k)
+    {
+      if (arrangements * m_coords[orient].size() > GROUP_PRUNING_CAP)
+        break;
+      arrangements *= pieces.size() - k - 1;
+    }
+
+    if (k == 0)
+      return;
+
+    addPruning(addCoord(makeProjection(corners, true, false,
+                                       std::vector<unsigned>(pieces.begin(), pieces.begin() + k))), orient);
+    addPruning(addCoord(makeProjection(corners, true, false,
+                                       std::vector<unsigned>(pieces.end() - k, pieces.end()))), orient);
+  }
+
+  static GroupProjection
+  makeProjection(bool corners, bool slots, bool orients, const std::vector<unsigned>& pieces)
+  {
+    GroupProjection p;
+    p.corners = corners;
+    p.slots = slots;
+    p.orients = orients;
+    p.pieces = pieces;
+    return p;
+  }
+
+  // Adds 'p', building it first if it has no values yet, and returns its
+  // position in m_coords
+  unsigned
+  addCoord(GroupProjection&& p)
+  {
+    if ((p.size() == 0 && !buildProjection(p)) || m_coords.size() == MAX_GROUP_COORDS)
+      throw std::length_error("move group needs too many or too large coordinates");
+
+    m_coords.push_back(std::move(p));
+    return m_coords.size() - 1;
+  }
+
+  // Enumerates the reachable keys with their move table and distances.
+  // Returns false if there are more than GROUP_COORD_CAP, which a single
+  // piece never has.
+  bool
+  buildProjection(GroupProjection& p) const
+  {
+    uint64_t solvedKey = 0;
+    if (p.slots)
+      for (unsigned i = 0; i < p.pieces.size(); ++i)
+        solvedKey |= (uint64_t) p.pieces[i] << (p.bits() * i);
+
+    // Keys are discovered in breadth-first order, which fills in the move
+    // table and the distances in the same pass
+    KeyIndex seen;
+    bool inserted;
+    seen.emplace(solvedKey, 0, inserted);
+
+    std::vector<uint64_t> keys(1, solvedKey);
+    p.distance.assign(1, 0);
+    p.moves.clear();
+    for (uint32_t head = 0; head < keys.size(); ++head)
+      for (uint8_t code : CODES)
+      {
+        uint64_t next = moveKey(p, keys[head], code);
+        uint32_t index = seen.emplace(next, keys.size(), inserted);
+        if (inserted)
+        {
+          if (keys.size() == GROUP_COORD_CAP)
+          {
+            p.distance.clear();
+            return false;
+          }
+
+          keys.push_back(next);
+          p.distance.push_back(p.distance[head] + 1);
+        }
+
+        p.moves.push_back(index);
+      }
+
+    p.index = seen.sorted();
+
+    return true;
+  }
+
+  // Breadth-first distances of every pair of values of coordinates 'a' and
+  // 'b', through their move tables. Each layer is found by scanning the
+  // table in order rather than from a queue: the children of one value of
+  // 'a' land in a few rows, so writes stay in cache for tables of millions.
+  void
+  addPruning(unsigned a, unsigned b)
+  {
+    const GroupProjection& first = m_coords[a];
+    const GroupProjection& second = m_coords[b];
+
+    GroupPruning p;
+    p.first = a;
+    p.second = b;
+    p.secondSize = second.size();
+    p.distance.assign((size_t) first.size() * second.size(), GROUP_UNREACHED);
+    p.distance[0] = 0;
+
+    bool grew = true;
+    for (uint8_t depth = 0; grew; ++depth)
+    {
+      grew = false;
+      for (uint32_t x = 0; x < first.size(); ++x)
+        for (uint32_t y = 0; y < p.secondSize; ++y)
+        {
+          if (p.distance[x * p.secondSize + y] != depth)
+            continue;
+
+          for (unsigned m = 0; m < MOVE_COUNT; ++m)
+          {
+            uint32_t j = first.moves[x * MOVE_COUNT + m] * p.secondSize + second.moves[y * MOVE_COUNT + m];
+            if (p.distance[j] == GROUP_UNREACHED)
+            {
+              p.distance[j] = depth + 1;
+              grew = true;
+            }
+          }
+        }
+    }
+
+    m_prunings.push_back(std::move(p));
+  }
+
+  uint64_t
+  moveKey(const GroupProjection& p, uint64_t key, uint8_t code) const
+  {
+    const PieceMoves::Kind& kind = p.corners ? m_pieceMoves.corners : m_pieceMoves.edges;
+    const unsigned orientations = p.corners ? 3 : 2;
+
+    uint64_t next = 0;
+    for (unsigned i = 0; i < p.pieces.size(); ++i)
+    {
+      unsigned field = (key >> (p.bits() * i)) & ((1u << p.bits()) - 1);
+      unsigned slot = p.slots ? field & 15 : p.pieces[i], orient = field >> p.orientShift();
+      unsigned nextOrient = p.orients ? (orient + kind.delta[code][slot]) % orientations : 0;
+      unsigned nextSlot = kind.dest[code][slot];
+
+      // Orientations are keyed by slot, so they move to the field of the
+      // slot the piece lands in. The group keeps its moved slots together.
+      unsigned position = i;
+      if (!p.slots)
+        position = std::find(p.pieces.begin(), p.pieces.end(), nextSlot) - p.pieces.begin();
+
+      unsigned nextField = (p.slots ? nextSlot : 0) | nextOrient << p.orientShift();
+      next |= (uint64_t) nextField << (p.bits() * position);
+    }
+
+    return next;
+  }
+
+  // Coordinates of 'cube'. Returns false if the group does not contain it:
+  // a piece the group never moves is out of place, or some coordinate or
+  // pruning pair is unreachable. Legal cubes combine the tracked parts only
+  // as the groups here do, so this is exact for them.
+  bool
+  project(const Cube& cube, state_t& state) const
+  {
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    cube.cubies(cp, co, ep, eo);
+
+    for (unsigned s = 0; s < CORNER_COUNT; ++s)
+      if (!m_cornerMoved[s] && (cp[s] != s || co[s] != 0))
+        return false;
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+      if (!m_edgeMoved[s] && (ep[s] != s || eo[s] != 0))
+        return false;
+
+    for (size_t j = 0; j < m_coords.size(); ++j)
+    {
+      const GroupProjection& p = m_coords[j];
+      const unsigned* perm = p.corners ? cp : ep;
+      const unsigned* orient = p.corners ? co : eo;
+      const unsigned slots = p.corners ? CORNER_COUNT : EDGE_COUNT;
+
+      uint64_t key = 0;
+      for (unsigned s = 0; s < slots; ++s)
+      {
+        // Slots are tracked per piece, orientations alone per slot
+        auto it = std::find(p.pieces.begin(), p.pieces.end(), p.slots ? perm[s] : s);
+        if (it == p.pieces.end())
+          continue;
+
+        unsigned field = (p.slots ? s : 0) | (p.orients ? orient[s] : 0) << p.orientShift();
+        key |= (uint64_t) field << (p.bits() * (it - p.pieces.begin()));
+      }
+
+      state[j] = p.find(key);
+      if (state[j] == p.size())
+        return false;
+    }
+
+    for (const auto& p : m_prunings)
+      if (p.distance[state[p.first] * p.secondSize + state[p.second]] == GROUP_UNREACHED)
+        return false;
+
+    return true;
+  }
+
+  unsigned
+  bound(const state_t& state) const
+  {
+    unsigned h = 0;
+    for (const auto& p : m_prunings)
+      h = std::max(h, (unsigned) p.distance[state[p.first] * p.secondSize + state[p.second]]);
+    for (unsigned j : m_standalone)
+      h = std::max(h, (unsigned) m_coords[j].distance[state[j]]);
+
+    return h;
+  }
+
+  // Depth-first search for a solution of exactly 'depth' moves. Every piece
+  // the group moves is tracked, so a bound of 0 means solved.
+  bool
+  search(const state_t& state, size_t g, size_t depth, unsigned lastFace, uint8_t* path) const
+  {
+    ++t_expandedNodes;
+    const uint32_t allowed = ALLOWED[lastFace];
+    for (unsigned i = 0; i < MOVE_COUNT; ++i)
+    {
+      if (!(allowed & (1u << i)))
+        continue;
+
+      state_t child;
+      for (size_t j = 0; j < m_coords.size(); ++j)
+        child[j] = m_coords[j].moves[state[j] * MOVE_COUNT + i];
+
+      if (g + 1 + bound(child) > depth)
+        continue;
+
+      path[g] = CODES[i];
+      if (g + 1 == depth || search(child, g + 1, depth, CODES[i] / 3, path))
+        return true;
+    }
+
+    return false;
+  }
+
+  PieceMoves m_pieceMoves;
+  bool m_cornerMoved[CORNER_COUNT];
+  bool m_edgeMoved[EDGE_COUNT];
+  std::vector<GroupProjection> m_coords;
+  std::vector<GroupPruning> m_prunings;
+  std::vector<unsigned> m_standalone;
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Sean Malloy
+ * Peephole.hpp
+ * Peephole optimizer that shortens suboptimal solutions. Adjacent moves on
+ * the same face (or on opposite faces, which commute) are merged, then every
+ * short window is replaced by an optimal sequence with the same effect taken
+ * from a table of all states within PEEPHOLE_DEPTH moves of solved.
+ */
+
+#ifndef PEEPHOLE_HPP
+#define PEEPHOLE_HPP
+
+/************************************************/
+// System includes
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+
+/************************************************/
+
+const unsigned PEEPHOLE_DEPTH  = 5;
+const unsigned PEEPHOLE_WINDOW = 12;
+
+// Moves are coded as face * 3 + (quarter turns - 1), matching the order
+// getStartMoves() produces them in: X, X2, X'.
+typedef std::vector<uint8_t> movecode_t;
+
+struct RankHash
+{
+  size_t
+  operator()(rank_t r) const
+  {
+    uint64_t h = (uint64_t) r ^ (uint64_t) (r >> 64) * 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h ^ (h >> 29));
+  }
+};
+
+/************************************************/
+
+inline unsigned
+codeFace(uint8_t code)
+{
+  return code / 3;
+}
+
+inline unsigned
+codeTurns(uint8_t code)
+{
+  return code % 3 + 1;
+}
+
+inline uint8_t
+makeCode(unsigned face, unsigned turns)
+{
+  return (uint8_t) (face * 3 + turns - 1);
+}
+
+inline movecode_t
+encodeMoves(const moveset_t& moves)
+{
+  movecode_t codes;
+  for (const auto& m : moves)
+  {
+    unsigned turns = m.size() == 1 ? 1 : (m[1] == '2' ? 2 : 3);
+    codes.push_back(makeCode(m_moveMap.at(m[0]), turns));
+  }
+
+  return codes;
+}
+
+inline moveset_t
+decodeMoves(const movecode_t& codes)
+{
+  const std::string suffixes[3] = { "", "2", "'" };
+
+  moveset_t moves;
+  for (uint8_t code : codes)
+    moves.push_back(MOVE_NAMES[codeFace(code)] + suffixes[codeTurns(code) - 1]);
+
+  return moves;
+}
+
+// Index of the face opposite 'face' in MOVE_NAMES
+inline unsigned
+oppositeFaceIndex(unsigned face)
+{
+  return m_moveMap.at(OPP_MOVE_NAMES[face]);
+}
+
+/************************************************/
+
+// Every state within 'depth' moves of solved, keyed by Cube::rank(), mapped
+// to one optimal sequence reaching it. Sequences are packed 5 bits per move
+// above a 4 bit length.
+class PeepholeTable
+{
+public:
+  explicit PeepholeTable(unsigned depth)
+    : m_depth(depth),
+      m_table()
+  {
+    std::vector<std::pair<Cube, uint64_t>> layer(1);
+    m_table[layer[0].first.rank()] = 0;
+
+    for (unsigned d = 1; d <= depth; ++d)
+    {
+      std::vector<std::pair<Cube, uint64_t>> next;
+      for (const auto& entry : layer)
+      {
+        unsigned length = entry.second & 0xF;
+        unsigned lastFace = length > 0 ? codeFace((entry.second >> (4 + 5 * (length - 1))) & 0x1F) : SIDE_COUNT;
+
+        for (unsigned face = 0; face < SIDE_COUNT; ++face)
+        {
+          if (face == lastFace)
+            continue;
+
+          Cube child(entry.first);
+          for (unsigned turns = 1; turns <= 3; ++turns)
+          {
+            child.turn(face, 1);
+            rank_t r = child.rank();
+            if (m_table.find(r) != m_table.end())
+              continue;
+
+            uint64_t packed = (entry.second & ~0xFULL) | ((uint64_t) makeCode(face, turns) << (4 + 5 * length)) | d;
+            m_table[r] = packed;
+            next.emplace_back(child, packed);
+          }
+        }
+      }
+
+      layer.swap(next);
+    }
+  }
+
+  // Shared table at PEEPHOLE_DEPTH, built on first use
+  static const PeepholeTable&
+  instance()
+  {
+    static PeepholeTable table(PEEPHOLE_DEPTH);
+    return table;
+  }
+
+  // Fills 'codes' with an optimal sequence whose effect is 'effect' if it is
+  // within the table depth
+  bool
+  lookup(const Cube& effect, movecode_t& codes) const
+  {
+    auto it = m_table.find(effect.rank());
+    if (it == m_table.end())
+      return false;
+
+    unsigned length = it->second & 0xF;
+    codes.resize(length);
+    for (unsigned i = 0; i < length; ++i)
+      codes[i] = (it->second >> (4 + 5 * i)) & 0x1F;
+
+    return true;
+  }
+
+  unsigned
+  depth() const
+  {
+    return m_depth;
+  }
+
+  size_t
+  size() const
+  {
+    return m_table.size();
+  }
+
+private:
+  unsigned m_depth;
+  std::unordered_map<rank_t, uint64_t, RankHash> m_table;
+};
+
+/************************************************/
+
+// Merges consecutive turns of the same face, including across a turn of the
+// opposite face since opposite faces commute. Turns that add up to a full
+// rotation are dropped.
+inline movecode_t
+cancelMoves(const movecode_t& codes)
+{
+  movecode_t out;
+  for (uint8_t code : codes)
+  {
+    unsigned face = codeFace(code);
+    size_t target = out.size();
+
+    if (out.size() >= 1 && codeFace(out.back()) == face)
+      target = out.size() - 1;
+    else if (out.size() >= 2 && codeFace(out.back()) == oppositeFaceIndex(face) &&
+             codeFace(out[out.size() - 2]) == face)
+      target = out.size() - 2;
+
+    if (target == out.size())
+    {
+      out.push_back(code);
+      continue;
+    }
+
+    unsigned turns = (codeTurns(out[target]) + codeTurns(code)) % 4;
+    if (turns == 0)
+      out.erase(out.begin() + target);
+    else
+      out[target] = makeCode(face, turns);
+  }
+
+  return out;
+}
+
+// Slides a window of up to PEEPHOLE_WINDOW moves over 'codes' and replaces
+// the window with the largest saving by its optimal equivalent. Returns
+// false if no window could be shortened.
+inline bool
+replaceWindow(movecode_t& codes, const PeepholeTable& table)
+{
+  movecode_t optimal;
+  for (size_t i = 0; i < codes.size(); ++i)
+  {
+    Cube effect;
+    size_t bestLength = 0;
+    movecode_t best;
+
+    for (size_t length = 1; length <= PEEPHOLE_WINDOW && i + length <= codes.size(); ++length)
+    {
+      effect.turn(codeFace(codes[i + length - 1]), codeTurns(codes[i + length - 1]));
+      if (length >= 2 && table.lookup(effect, optimal) && optimal.size() < length &&
+          length - optimal.size() >= bestLength - best.size())
+      {
+        bestLength = length;
+        best = optimal;
+      }
+    }
+
+    if (bestLength > 0)
+    {
+      codes.erase(codes.begin() + i, codes.begin() + i + bestLength);
+      codes.insert(codes.begin() + i, best.begin(), best.end());
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Shortens 'solution' without changing its effect. Alternates cancellation
+// and window replacement until neither makes progress.
+inline moveset_t
+optimizeSolution(const moveset_t& solution, const PeepholeTable& table = PeepholeTable::instance())
+{
+  movecode_t codes = cancelMoves(encodeMoves(solution));
+  while (replaceWindow(codes, table))
+    codes = cancelMoves(codes);
+
+  return decodeMoves(codes);
+}
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * Sean Malloy
+ * PerfCounters.hpp
+ * Optional hardware performance counter profiling built on perf_event_open.
+ * Enabled by setting CUBE_PERF=1 in the environment.
+ */
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+/************************************************/
+// System includes
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Timer.hpp"
+
+/************************************************/
+
+enum PerfEvent
+{
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  PERF_EVENT_COUNT
+};
+
+// Counter values for one measured region. A counter the kernel or hardware
+// cannot provide (e.g. inside most VMs) is left unset in 'valid'.
+struct PerfSample
+{
+  uint64_t values[PERF_EVENT_COUNT] = { };
+  bool valid[PERF_EVENT_COUNT] = { };
+  uint64_t nodes = 0;
+  double ms = 0;
+};
+
+// Expansions performed by the current thread. Searches bump this once per
+// expanded node so a PerfScope can report misses per node.
+inline thread_local uint64_t t_expandedNodes = 0;
+
+/************************************************/
+
+// One set of counters measuring user-space activity of the calling thread.
+class PerfCounters
+{
+public:
+  PerfCounters()
+  {
+    const uint32_t types[PERF_EVENT_COUNT] =
+      { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE };
+    const uint64_t configs[PERF_EVENT_COUNT] =
+    {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    for (unsigned e = 0; e < PERF_EVENT_COUNT; ++e)
+    {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = types[e];
+      attr.config = configs[e];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      m_fds[e] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  ~PerfCounters()
+  {
+    for (unsigned e = 0; e < PERF_EVENT_COUNT; ++e)
+      if (m_fds[e] >= 0)
+        close(m_fds[e]);
+  }
+
+  void
+  start()
+  {
+    for (unsigned e = 0; e < PERF_EVENT_COUNT; ++e)
+      if (m_fds[e] >= 0)
+      {
+        ioctl(m_fds[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fds[e], PERF_EVENT_IOC_ENABLE, 0);
+      }
+  }
+
+  // Stops counting and fills in every counter that could be read. Counts are
+  // scaled up if the kernel had to multiplex the events.
+  void
+  stop(PerfSample& sample)
+  {
+    for (unsigned e = 0; e < PERF_EVENT_COUNT; ++e)
+    {
+      if (m_fds[e] < 0)
+        continue;
+
+      ioctl(m_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+
+      uint64_t data[3];
+      if (read(m_fds[e], data, sizeof(data)) != sizeof(data) || data[2] == 0)
+        continue;
+
+      sample.values[e] = data[2] < data[1] ? (uint64_t) ((double) data[0] * data[1] / data[2]) : data[0];
+      sample.valid[e] = true;
+    }
+  }
+
+private:
+  int m_fds[PERF_EVENT_COUNT];
+};
+
+/************************************************/
+
+// Process-wide collection of measured regions, printed after the solve.
+// Regions with the same phase and thread are summed into one row, so a
+// long-running process that never prints keeps a bounded profile.
+class PerfProfile
+{
+  struct Entry
+  {
+    std::string phase;
+    unsigned thread;
+    PerfSample sample;
+  };
+
+public:
+  static PerfProfile&
+  instance()
+  {
+    static PerfProfile profile;
+    return profile;
+  }
+
+  bool
+  enabled() const
+  {
+    return m_enabled;
+  }
+
+  void
+  record(const std::string& phase, unsigned thread, const PerfSample& sample)
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    for (auto& entry : m_entries)
+    {
+      if (entry.phase != phase || entry.thread != thread)
+        continue;
+
+      // A counter is only shown if every summed region measured it
+      for (unsigned e = 0; e < PERF_EVENT_COUNT; ++e)
+      {
+        entry.sample.values[e] += sample.values[e];
+        entry.sample.valid[e] = entry.sample.valid[e] && sample.valid[e];
+      }
+      entry.sample.nodes += sample.nodes;
+      entry.sample.ms += sample.ms;
+      return;
+    }
+
+    m_entries.push_back({ phase, thread, sample });
+  }
+
+  // One row per phase and thread: wall time, cycles, IPC and misses per
+  // expanded node. Printed rows are cleared, so the next print() covers only
+  // what ran since.
+  void
+  print(FILE* out)
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (!m_enabled)
+      return;
+
+    fprintf(out, "\n%-14s %6s %10s %12s %6s %10s %10s %10s %12s\n",
+            "Phase", "Thread", "Time (ms)", "Cycles", "IPC", "L1D/node", "LLC/node", "Br/node", "Nodes");
+    for (const auto& entry : m_entries)
+    {
+      const PerfSample& s = entry.sample;
+      fprintf(out, "%-14s %6u %10.3f ", entry.phase.c_str(), entry.thread, s.ms);
+      printCount(out, s, PERF_CYCLES, 12);
+
+      if (s.valid[PERF_CYCLES] && s.valid[PERF_INSTRUCTIONS] && s.values[PERF_CYCLES] > 0)
+        fprintf(out, " %6.2f", (double) s.values[PERF_INSTRUCTIONS] / s.values[PERF_CYCLES]);
+      else
+        fprintf(out, " %6s", "n/a");
+
+      printPerNode(out, s, PERF_L1D_MISSES);
+      printPerNode(out, s, PERF_LLC_MISSES);
+      printPerNode(out, s, PERF_BRANCH_MISSES);
+      fprintf(out, " %12llu\n", (unsigned long long) s.nodes);
+    }
+
+    m_entries.clear();
+  }
+
+private:
+  PerfProfile()
+    : m_enabled(getenv("CUBE_PERF") != nullptr && strcmp(getenv("CUBE_PERF"), "0") != 0),
+      m_entries(),
+      m_lock()
+  { }
+
+  static void
+  printCount(FILE* out, const PerfSample& s, PerfEvent e, int width)
+  {
+    if (s.valid[e])
+      fprintf(out, "%*llu", width, (unsigned long long) s.values[e]);
+    else
+      fprintf(out, "%*s", width, "n/a");
+  }
+
+  static void
+  printPerNode(FILE* out, const PerfSample& s, PerfEvent e)
+  {
+    if (s.valid[e] && s.nodes > 0)
+      fprintf(out, " %10.2f", (double) s.values[e] / s.nodes);
+    else
+      fprintf(out, " %10s", "n/a");
+  }
+
+  bool m_enabled;
+  std::vector<Entry> m_entries;
+  std::mutex m_lock;
+};
+
+/************************************************/
+
+// Measures the calling thread from construction to destruction and records
+// the result under 'phase'. Does nothing unless profiling is enabled.
+class PerfScope
+{
+public:
+  PerfScope(const std::string& phase, unsigned thread = 0)
+    : m_phase(phase),
+      m_thread(thread),
+      m_counters(),
+      m_startNodes(t_expandedNodes),
+      m_timer()
+  {
+    if (!PerfProfile::instance().enabled())
+      return;
+
+    m_counters.reset(new PerfCounters());
+    m_timer.start();
+    m_counters->start();
+  }
+
+  PerfScope(const PerfScope&) = delete;
+  PerfScope& operator=(const PerfScope&) = delete;
+
+  ~PerfScope()
+  {
+    if (!m_counters)
+      return;
+
+    PerfSample sample;
+    m_counters->stop(sample);
+    m_timer.stop();
+
+    sample.ms = m_timer.elapsed();
+    sample.nodes = t_expandedNodes - m_startNodes;
+    PerfProfile::instance().record(m_phase, m_thread, sample);
+  }
+
+private:
+  std::string m_phase;
+  unsigned m_thread;
+  std::unique_ptr<PerfCounters> m_counters;
+  uint64_t m_startNodes;
+  Timer m_timer;
+};
+
+#endif
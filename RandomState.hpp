@@ -0,0 +1,585 @@
+/*
+ * Sean Malloy
+ * RandomState.hpp
+ * Uniformly random legal cube states for benchmarks and load tests.
+ *
+ * States are drawn at the cubie level: uniform corner and edge permutations
+ * with the edge parity matched to the corner parity, and uniform
+ * orientations whose last twist and flip are implied by the others. Every
+ * reachable state is therefore equally likely, unlike short random-move
+ * scrambles.
+ *
+ * A scramble producing a state is built the way blindfolded solvers do it:
+ * one cubie at a time by pure 3-cycles taken from a catalog of commutators
+ * and their conjugates, and the result inverted. Such scrambles are
+ * correct but far from optimal, around 190 moves.
+ */
+
+#ifndef RANDOM_STATE_HPP
+#define RANDOM_STATE_HPP
+
+/************************************************/
+// System includes
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Peephole.hpp"
+
+/************************************************/
+
+// States are generated in chunks, each from its own PRNG stream, so the
+// output depends only on the seed and not on the number of threads
+const size_t RANDOM_CHUNK_SIZE = 4096;
+
+// Longest commutator arm tried when seeding the 3-cycle catalog
+const unsigned COMMUTATOR_ARM_LENGTH = 3;
+
+// Directed 3-cycles with every orientation change that keeps the sum fixed
+const size_t CORNER_CYCLE_COUNT = 8 * 7 * 6 / 3 * 9;
+const size_t EDGE_CYCLE_COUNT   = 12 * 11 * 10 / 3 * 4;
+
+/************************************************/
+
+inline uint64_t
+splitMix64(uint64_t& x)
+{
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// xoshiro256** seeded through splitmix64. Distinct streams of one seed are
+// statistically independent.
+class Xoshiro256
+{
+public:
+  Xoshiro256(uint64_t seed, uint64_t stream = 0)
+  {
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (auto& s : m_state)
+      s = splitMix64(x);
+  }
+
+  uint64_t
+  next()
+  {
+    uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+    uint64_t t = m_state[1] << 17;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = rotl(m_state[3], 45);
+
+    return result;
+  }
+
+  // Uniform in [0, bound) without modulo bias (Lemire's method)
+  uint32_t
+  below(uint32_t bound)
+  {
+    uint64_t m = (next() >> 32) * bound;
+    if ((uint32_t) m < bound)
+    {
+      uint32_t threshold = -bound % bound;
+      while ((uint32_t) m < threshold)
+        m = (next() >> 32) * bound;
+    }
+
+    return (uint32_t) (m >> 32);
+  }
+
+private:
+  static uint64_t
+  rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t m_state[4];
+};
+
+/************************************************/
+
+// Fisher-Yates shuffle of the identity permutation. N! fits in 32 bits, so
+// the swap targets are the mixed-radix digits of a single random number.
+// Returns the parity, which flips with every swap of two distinct slots.
+template<unsigned N>
+inline unsigned
+randomPermutation(Xoshiro256& rng, unsigned perm[N], uint32_t states)
+{
+  for (unsigned i = 0; i < N; ++i)
+    perm[i] = i;
+
+  uint32_t r = rng.below(states);
+  unsigned parity = 0;
+#pragma GCC unroll 16
+  for (unsigned i = N - 1; i > 0; --i)
+  {
+    unsigned j = r % (i + 1);
+    std::swap(perm[i], perm[j]);
+    parity ^= j != i;
+    r /= i + 1;
+  }
+
+  return parity;
+}
+
+// N orientations modulo K summing to a multiple of K, drawn as one number
+template<unsigned N, unsigned K>
+inline void
+randomOrientation(Xoshiro256& rng, unsigned orient[N], uint32_t states)
+{
+  uint32_t r = rng.below(states);
+  unsigned sum = 0;
+  for (unsigned i = 0; i < N - 1; ++i)
+  {
+    orient[i] = r % K;
+    sum += orient[i];
+    r /= K;
+  }
+
+  orient[N - 1] = (K - sum % K) % K;
+}
+
+// One uniformly random reachable state
+inline Cube
+randomState(Xoshiro256& rng)
+{
+  unsigned cornerPerm[CORNER_COUNT], cornerOrient[CORNER_COUNT];
+  unsigned edgePerm[EDGE_COUNT], edgeOrient[EDGE_COUNT];
+
+  unsigned cornerParity = randomPermutation<CORNER_COUNT>(rng, cornerPerm, CORNER_PERM_COUNT);
+  unsigned edgeParity = randomPermutation<EDGE_COUNT>(rng, edgePerm, EDGE_PERM_COUNT);
+  randomOrientation<CORNER_COUNT, 3>(rng, cornerOrient, CORNER_ORIENT_COUNT);
+  randomOrientation<EDGE_COUNT, 2>(rng, edgeOrient, EDGE_ORIENT_COUNT);
+
+  // Swapping two edges maps each mismatched draw to a distinct legal state,
+  // so the result stays uniform
+  if (edgeParity != cornerParity)
+    std::swap(edgePerm[EDGE_COUNT - 2], edgePerm[EDGE_COUNT - 1]);
+
+  return Cube::fromCubies(cornerPerm, cornerOrient, edgePerm, edgeOrient);
+}
+
+/************************************************/
+
+// Builds a scramble for any reachable state out of pure 3-cycles
+class ScrambleBuilder
+{
+  // A word moving the content of one slot to another and a third slot to
+  // the first, touching nothing else
+  struct Cycle
+  {
+    movecode_t word;
+    unsigned third;
+  };
+
+public:
+  ScrambleBuilder()
+    : m_cornerCycles(CORNER_COUNT * CORNER_COUNT),
+      m_edgeCycles(EDGE_COUNT * EDGE_COUNT),
+      m_cornerTwists(3),
+      m_edgeFlip(),
+      m_cornerCount(0),
+      m_edgeCount(0)
+  {
+    std::vector<movecode_t> sequences = canonicalSequences();
+
+    // Commutators X Y X' Y' of a short sequence and a single move
+    std::unordered_set<rank_t, RankHash> seen;
+    std::vector<movecode_t> found;
+    for (const auto& x : canonicalSequences())
+      for (uint8_t y = 0; y < START_MOVE_COUNT; ++y)
+      {
+        movecode_t word(x);
+        word.push_back(y);
+        append(word, inverse(x));
+        word.push_back(inverse(y));
+        consider(word, seen, found);
+      }
+
+    // Every pure 3-cycle is a conjugate of those, so conjugating each new
+    // cycle by single moves reaches the rest, shortest setups first
+    for (size_t i = 0; i < found.size() && !complete(); ++i)
+      for (uint8_t m = 0; m < START_MOVE_COUNT; ++m)
+      {
+        movecode_t word;
+        word.reserve(found[i].size() + 2);
+        word.push_back(m);
+        append(word, found[i]);
+        word.push_back(inverse(m));
+        consider(word, seen, found);
+      }
+
+    // Twisting or flipping the last two pieces in place takes two cycles
+    // through a third, already solved piece
+    for (unsigned twist = 1; twist < 3; ++twist)
+    {
+      unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+      Cube().cubies(cp, co, ep, eo);
+      co[CORNER_COUNT - 2] = twist;
+      co[CORNER_COUNT - 1] = 3 - twist;
+      m_cornerTwists[twist] = pairFixing(Cube::fromCubies(cp, co, ep, eo), m_cornerCycles, CORNER_COUNT);
+    }
+
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    Cube().cubies(cp, co, ep, eo);
+    eo[EDGE_COUNT - 2] = eo[EDGE_COUNT - 1] = 1;
+    m_edgeFlip = pairFixing(Cube::fromCubies(cp, co, ep, eo), m_edgeCycles, EDGE_COUNT);
+  }
+
+  // Shared builder, constructed on first use
+  static const ScrambleBuilder&
+  instance()
+  {
+    static ScrambleBuilder builder;
+    return builder;
+  }
+
+  // True once every 3-cycle has been found
+  bool
+  complete() const
+  {
+    return m_cornerCount == CORNER_CYCLE_COUNT && m_edgeCount == EDGE_CYCLE_COUNT;
+  }
+
+  // A move sequence taking the solved cube to 'state'
+  moveset_t
+  scramble(const Cube& state) const
+  {
+    movecode_t solution;
+    Cube work(state);
+
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    work.cubies(cp, co, ep, eo);
+
+    // 3-cycles are even, so an odd state is made even by one quarter turn
+    if (Cube::permutationParity<CORNER_COUNT>(cp) != 0)
+      apply(work, solution, movecode_t(1, makeCode(0, 1)));
+
+    placePieces<true>(work, solution, m_cornerCycles, CORNER_COUNT);
+    work.cubies(cp, co, ep, eo);
+    if (co[CORNER_COUNT - 2] != 0)
+      apply(work, solution, m_cornerTwists[co[CORNER_COUNT - 2]]);
+
+    placePieces<false>(work, solution, m_edgeCycles, EDGE_COUNT);
+    work.cubies(cp, co, ep, eo);
+    if (eo[EDGE_COUNT - 2] != 0)
+      apply(work, solution, m_edgeFlip);
+
+    return decodeMoves(cancelMoves(inverse(solution)));
+  }
+
+private:
+  static void
+  append(movecode_t& word, const movecode_t& tail)
+  {
+    word.insert(word.end(), tail.begin(), tail.end());
+  }
+
+  static uint8_t
+  inverse(uint8_t code)
+  {
+    return makeCode(codeFace(code), 4 - codeTurns(code));
+  }
+
+  static movecode_t
+  inverse(const movecode_t& word)
+  {
+    movecode_t out(word.rbegin(), word.rend());
+    for (auto& code : out)
+      code = inverse(code);
+
+    return out;
+  }
+
+  static void
+  apply(Cube& cube, movecode_t& solution, const movecode_t& word)
+  {
+    for (uint8_t code : word)
+      cube.turn(codeFace(code), codeTurns(code));
+    append(solution, word);
+  }
+
+  // Canonical sequences of 1 to COMMUTATOR_ARM_LENGTH moves, shortest first
+  static std::vector<movecode_t>
+  canonicalSequences()
+  {
+    std::vector<movecode_t> out;
+    std::vector<movecode_t> layer(1);
+    for (unsigned length = 1; length <= COMMUTATOR_ARM_LENGTH; ++length)
+    {
+      std::vector<movecode_t> next;
+      for (const auto& seq : layer)
+        for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+        {
+          if (seq.size() > 0)
+          {
+            unsigned face = codeFace(code);
+            unsigned prev = codeFace(seq.back());
+            if (face == prev || (prev == oppositeFaceIndex(face) && face < prev))
+              continue;
+          }
+
+          next.push_back(seq);
+          next.back().push_back(code);
+        }
+
+      out.insert(out.end(), next.begin(), next.end());
+      layer.swap(next);
+    }
+
+    return out;
+  }
+
+  // Records 'word' if it is a pure 3-cycle of corners or of edges whose
+  // effect has not been seen yet, and appends it to 'found'
+  void
+  consider(const movecode_t& word, std::unordered_set<rank_t, RankHash>& seen, std::vector<movecode_t>& found)
+  {
+    Cube effect;
+    for (uint8_t code : word)
+      effect.turn(codeFace(code), codeTurns(code));
+
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    effect.cubies(cp, co, ep, eo);
+
+    unsigned cornerMoved = 0, edgeMoved = 0;
+    bool cornerTwisted = false, edgeFlipped = false;
+    for (unsigned s = 0; s < CORNER_COUNT; ++s)
+    {
+      cornerMoved += cp[s] != s;
+      cornerTwisted |= cp[s] == s && co[s] != 0;
+    }
+    for (unsigned s = 0; s < EDGE_COUNT; ++s)
+    {
+      edgeMoved += ep[s] != s;
+      edgeFlipped |= ep[s] == s && eo[s] != 0;
+    }
+
+    bool corners = cornerMoved == 3 && edgeMoved == 0 && !cornerTwisted && !edgeFlipped;
+    bool edges = edgeMoved == 3 && cornerMoved == 0 && !cornerTwisted && !edgeFlipped;
+    if ((!corners && !edges) || !seen.insert(effect.rank()).second)
+      return;
+
+    const unsigned count = corners ? CORNER_COUNT : EDGE_COUNT;
+    const unsigned* perm = corners ? cp : ep;
+    auto& buckets = corners ? m_cornerCycles : m_edgeCycles;
+    ++(corners ? m_cornerCount : m_edgeCount);
+    found.push_back(cancelMoves(word));
+
+    // Slot 'dst' now holds what was in slot perm[dst]. The cycle is filed
+    // under each of its three moves.
+    for (unsigned dst = 0; dst < count; ++dst)
+      if (perm[dst] != dst)
+        buckets[perm[dst] * count + dst].push_back({ found.back(), perm[perm[dst]] });
+  }
+
+  // Shortest pair of cycles through slot 0 and the last two slots that
+  // solves 'target'
+  static movecode_t
+  pairFixing(const Cube& target, const std::vector<std::vector<Cycle>>& buckets, unsigned count)
+  {
+    const unsigned slots[3] = { 0, count - 2, count - 1 };
+    std::vector<const movecode_t*> words;
+    for (unsigned a = 0; a < 3; ++a)
+      for (unsigned b = 0; b < 3; ++b)
+        if (a != b)
+          for (const auto& cycle : buckets[slots[a] * count + slots[b]])
+            if (cycle.third == slots[3 - a - b])
+              words.push_back(&cycle.word);
+
+    movecode_t best;
+    for (const auto* first : words)
+      for (const auto* second : words)
+      {
+        if (best.size() > 0 && first->size() + second->size() >= best.size())
+          continue;
+
+        Cube cube(target);
+        movecode_t word;
+        apply(cube, word, *first);
+        apply(cube, word, *second);
+        if (cube.isSolved())
+          best = word;
+      }
+
+    return best;
+  }
+
+  // Solves every slot but the last two, in order, by 3-cycles whose other
+  // two slots are not yet solved
+  template<bool CORNERS>
+  static void
+  placePieces(Cube& work, movecode_t& solution, const std::vector<std::vector<Cycle>>& buckets, unsigned count)
+  {
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    const unsigned* perm = CORNERS ? cp : ep;
+    const unsigned* orient = CORNERS ? co : eo;
+
+    for (unsigned i = 0; i + 2 < count; ++i)
+    {
+      work.cubies(cp, co, ep, eo);
+      if (perm[i] == i && orient[i] == 0)
+        continue;
+
+      unsigned from = 0;
+      while (perm[from] != i)
+        ++from;
+
+      // A piece twisted in place is first cycled out to the last slot
+      if (from == i)
+      {
+        for (const auto& cycle : buckets[i * count + count - 1])
+          if (cycle.third > i)
+          {
+            apply(work, solution, cycle.word);
+            break;
+          }
+
+        work.cubies(cp, co, ep, eo);
+        from = count - 1;
+      }
+
+      for (const auto& cycle : buckets[from * count + i])
+      {
+        if (cycle.third < i)
+          continue;
+
+        Cube trial(work);
+        for (uint8_t code : cycle.word)
+          trial.turn(codeFace(code), codeTurns(code));
+
+        trial.cubies(cp, co, ep, eo);
+        if (perm[i] == i && orient[i] == 0)
+        {
+          work = trial;
+          append(solution, cycle.word);
+          break;
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<Cycle>> m_cornerCycles;
+  std::vector<std::vector<Cycle>> m_edgeCycles;
+  std::vector<movecode_t> m_cornerTwists;
+  movecode_t m_edgeFlip;
+  size_t m_cornerCount;
+  size_t m_edgeCount;
+};
+
+/************************************************/
+
+// Runs 'body(rng, begin, end)' for every chunk of [0, count) on 'p'
+// threads. Chunk c always uses stream c of 'seed'.
+template<typename Body>
+inline void
+forEachRandomChunk(size_t count, uint64_t seed, unsigned p, Body body)
+{
+  size_t chunks = (count + RANDOM_CHUNK_SIZE - 1) / RANDOM_CHUNK_SIZE;
+  if (p == 0)
+    p = 1;
+
+  auto worker = [&](unsigned tid)
+  {
+    for (size_t c = tid; c < chunks; c += p)
+    {
+      Xoshiro256 rng(seed, c);
+      size_t begin = c * RANDOM_CHUNK_SIZE;
+      body(rng, begin, std::min(begin + RANDOM_CHUNK_SIZE, count));
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned tid = 1; tid < p; ++tid)
+    threads.emplace_back(worker, tid);
+  worker(0);
+
+  for (auto& t : threads)
+    t.join();
+}
+
+// Fills 'out[0, count)' with uniformly random states on 'p' threads. The
+// result depends only on 'seed'.
+inline void
+generateRandomStates(Cube* out, size_t count, uint64_t seed, unsigned p)
+{
+  forEachRandomChunk(count, seed, p, [out](Xoshiro256& rng, size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      out[i] = randomState(rng);
+  });
+}
+
+// The same states as generateRandomStates(), as scrambles producing them
+inline std::vector<moveset_t>
+generateRandomScrambles(size_t count, uint64_t seed, unsigned p)
+{
+  const ScrambleBuilder& builder = ScrambleBuilder::instance();
+  std::vector<moveset_t> out(count);
+
+  forEachRandomChunk(count, seed, p, [&out, &builder](Xoshiro256& rng, size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+      out[i] = builder.scramble(randomState(rng));
+  });
+
+  return out;
+}
+
+// The same scrambles as generateRandomScrambles(), written to 'out' one per
+// line as their chunks finish. Chunks are written in order and each thread
+// holds only the text of its current chunk, so memory does not grow with
+// 'count'.
+inline void
+writeRandomScrambles(std::ostream& out, size_t count, uint64_t seed, unsigned p)
+{
+  const ScrambleBuilder& builder = ScrambleBuilder::instance();
+  std::mutex lock;
+  std::condition_variable written;
+  size_t nextChunk = 0;
+
+  forEachRandomChunk(count, seed, p, [&](Xoshiro256& rng, size_t begin, size_t end)
+  {
+    std::string text;
+    for (size_t i = begin; i < end; ++i)
+    {
+      moveset_t scramble = builder.scramble(randomState(rng));
+      for (size_t m = 0; m < scramble.size(); ++m)
+      {
+        if (m > 0)
+          text += ' ';
+        text += scramble[m];
+      }
+      text += '\n';
+    }
+
+    // Every thread takes its chunks in increasing order, so the one before
+    // this chunk is always finished or in progress
+    size_t chunk = begin / RANDOM_CHUNK_SIZE;
+    std::unique_lock<std::mutex> guard(lock);
+    written.wait(guard, [&nextChunk, chunk] { return nextChunk == chunk; });
+    out.write(text.data(), text.size());
+    ++nextChunk;
+    written.notify_all();
+  });
+}
+
+#endif
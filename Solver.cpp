@@ -0,0 +1,1764 @@
+/*
+ * Sean Malloy
+ * Solver.cpp
+ * Search algorithms behind the Solver interface: BFS, A*, iterative
+ * deepening and the anytime solver, each serial and parallel. Parallel
+ * versions run their threads as a gang on the Solver's worker pool.
+ */
+/************************************************/
+// System includes
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <future>
+#include <stack>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+/************************************************/
+// Local includes
+#include "Solver.hpp"
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Timer.hpp"
+#include "SpscRing.hpp"
+#include "PerfCounters.hpp"
+#include "Peephole.hpp"
+#include "Enumerator.hpp"
+#include "CubeBatch.hpp"
+#include "MemoryBudget.hpp"
+#include "Coordinates.hpp"
+#include "MoveGroup.hpp"
+#include "TwoPhase.hpp"
+#include "ThreadPool.hpp"
+
+/************************************************/
+// Typedefs/structs
+// Everything but the Solver members is internal to this file
+namespace
+{
+
+struct CubeState
+{
+  CubeState()
+    : cube(),
+      solution()
+  { }
+
+  CubeState(const Cube& otherCube)
+    : cube(otherCube),
+      solution()
+  { }
+
+  CubeState(const CubeState& state)
+    : cube(state.cube),
+      solution(state.solution)
+  { }
+
+  CubeState(CubeState&& state) = default;
+  CubeState& operator=(const CubeState& state) = default;
+  CubeState& operator=(CubeState&& state) = default;
+
+  bool
+  operator<(const CubeState& state) const
+  {
+    return cube < state.cube;
+  }
+
+  Cube cube;
+  moveset_t solution;
+};
+
+// Shared stopping condition for both anytime passes. A node budget of 0 is
+// unlimited.
+struct SearchBudget
+{
+  SearchBudget(const Deadline& d, size_t nodes)
+    : deadline(d),
+      nodeBudget(nodes),
+      expanded(0)
+  { }
+
+  // Checks the clock only every 1024 expansions to keep it off the hot path
+  bool
+  exhausted() const
+  {
+    if (nodeBudget > 0 && expanded >= nodeBudget)
+      return true;
+
+    return (expanded & 1023) == 0 && deadline.expired();
+  }
+
+  const Deadline& deadline;
+  size_t nodeBudget;
+  size_t expanded;
+};
+
+// Priority queue of states that can tell whether pushes would grow its
+// vector past the memory cap. Growing keeps the old and new buffers alive
+// together, so a frontier that only polled overBudget() could end at twice
+// the cap.
+template<typename Compare>
+struct CappedFrontier : std::priority_queue<CubeState, std::vector<CubeState>, Compare>
+{
+  // True if 'count' more states fit without reallocating, or if the
+  // reallocation stays under the cap
+  bool
+  hasRoom(size_t count) const
+  {
+    if (this->c.size() + count <= this->c.capacity())
+      return true;
+
+    size_t grown = std::max(this->c.size() + count, 2 * this->c.capacity());
+    return MemoryGovernor::instance().hasRoom(grown * sizeof(CubeState));
+  }
+};
+
+// Growing a frontier vector moves its states only if this holds, and copies
+// every solution otherwise
+static_assert(std::is_nothrow_move_constructible<CubeState>::value, "CubeState moves must not throw");
+
+typedef std::queue<CubeState> frontierBFS_t;
+
+// BFS expands this many frontier states at a time through a CubeBatch
+const size_t BFS_BATCH_SIZE = 256;
+typedef CappedFrontier<std::less<CubeState>> frontierAStar_t;
+typedef std::stack<CubeState> frontierID_t;
+
+// Outcome of one bounded depth-first pass in the anytime solver.
+enum class DepthResult { FOUND, EXHAUSTED, OUT_OF_BUDGET };
+
+// Every child of one node together with its lower bound, filled in by
+// expandChildren() before any child is searched.
+struct Expansion
+{
+  CoordState children[START_MOVE_COUNT];
+  int bounds[START_MOVE_COUNT];
+  unsigned moves[START_MOVE_COUNT];
+  unsigned count;
+};
+
+// Orders HDA* open lists by f = g + Cube::movesLowerBound(), smallest first.
+// The bound is consistent, so a state is never reopened through a cheaper path
+// once expanded by its owner.
+struct HDACompare
+{
+  bool
+  operator()(const CubeState& a, const CubeState& b) const
+  {
+    return f(a) > f(b);
+  }
+
+  static size_t
+  f(const CubeState& state)
+  {
+    return state.solution.size() + state.cube.movesLowerBound();
+  }
+};
+
+const size_t HDA_BATCH_SIZE   = 64;
+const size_t HDA_MAILBOX_SIZE = 256;
+
+typedef CappedFrontier<HDACompare> frontierHDA_t;
+typedef std::unordered_map<Cube, size_t, CubeHash> closedHDA_t;
+typedef std::vector<CubeState> mailBatch_t;
+typedef SpscRing<mailBatch_t> mailbox_t;
+
+// Per-worker termination detection state, padded to its own cache line.
+struct alignas(64) HDAWorkerStatus
+{
+  std::atomic<bool> idle{false};
+  std::atomic<size_t> sent{0};
+  std::atomic<size_t> received{0};
+};
+
+// State shared by every HDA* worker. mailbox(from, to) is only ever pushed by
+// 'from' and popped by 'to'.
+struct HDAShared
+{
+  HDAShared(unsigned threads)
+    : p(threads),
+      mailboxes(),
+      status(threads),
+      terminate(false),
+      outOfMemory(false),
+      bestLength(SIZE_MAX),
+      best(),
+      lock()
+  {
+    for (unsigned i = 0; i < p * p; ++i)
+      mailboxes.emplace_back(new mailbox_t(HDA_MAILBOX_SIZE));
+  }
+
+  mailbox_t&
+  mailbox(unsigned from, unsigned to)
+  {
+    return *mailboxes[from * p + to];
+  }
+
+  unsigned p;
+  std::vector<std::unique_ptr<mailbox_t>> mailboxes;
+  std::vector<HDAWorkerStatus> status;
+  std::atomic<bool> terminate;
+  std::atomic<bool> outOfMemory;
+  std::atomic<size_t> bestLength;
+  moveset_t best;
+  std::mutex lock;
+};
+
+/************************************************/
+// Forward declarations
+
+moveset_t
+serialID(Cube& cube);
+
+moveset_t
+serialIDHelper(frontierID_t& frontier, const moveset_t& moves, size_t maxDepth);
+
+// Parallel iterative deepening. Every depth splits the first moves across a
+// gang of 'p' workers from 'pool'.
+moveset_t
+parallelID(Cube& cube, unsigned p, ThreadPool& pool);
+
+CubeState
+parallelIDHelper(frontierID_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, size_t maxDepth, unsigned tid);
+
+// Returns strings representing all start moves based on face names.
+moveset_t
+getStartMoves(const std::string& faceNames);
+
+// Serial Breadth-First Search. First level is populated with every possible
+// starting move. Each vertex is one CubeState struct instance with a copy of
+// cube and a solution vector. Sets 'bounded' if the memory cap handed the
+// search over to boundedSearch().
+moveset_t
+serialBFS(Cube& cube, bool& bounded);
+
+// Serial Breadth-First search helper that searches all nodes after the inital
+// starting moves. Only adds states to the frontier if the moves don't show
+// they are looping infinitely, saving space. Returns first solution that is
+// found.
+moveset_t
+serialBFSHelper(frontierBFS_t& frontier, const moveset_t& moves);
+
+// Parallel Breadth-First Search on a gang of 'p' workers from 'pool'. First
+// level is populated with every possible starting move, and partitioned to the
+// workers. Those workers then search their section of the graph until a
+// solution is found by one of them. That solution is returned and all other
+// states are ignored. Sets 'bounded' if the memory cap handed the search over
+// to boundedSearch().
+moveset_t
+parallelBFS(Cube& cube, unsigned p, ThreadPool& pool, bool& bounded);
+
+// Parallel Breadth-First search helper where each node searches their section
+// of the graph. Only adds states to the frontier if the moves don't show they
+// are looping infinitely, saving space. Returns once one thread finishes (i.e.
+// solution is at front of local frontier), indicated by the shared bool 'finished',
+// or with an unsolved state once the memory cap is reached.
+CubeState
+parallelBFSHelper(frontierBFS_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, unsigned tid);
+
+// Moves up to BFS_BATCH_SIZE states from the front of 'frontier' into
+// 'chunk' and their cubes into 'parents'. Stops at the first state one move
+// deeper, so a chunk never spans two BFS layers.
+void
+popBFSChunk(frontierBFS_t& frontier, std::vector<CubeState>& chunk, CubeBatch& parents);
+
+// Applies each move to the whole chunk at once and pushes the children that
+// pass uniqueMoves() onto 'frontier'. Returns true with 'solved' set as soon
+// as a child is solved.
+bool
+expandBFSChunk(const std::vector<CubeState>& chunk, const CubeBatch& parents, CubeBatch& children,
+               const moveset_t& moves, const movecode_t& codes, frontierBFS_t& frontier, CubeState& solved);
+
+// Serial A* search, adapted from BFS. Sets 'bounded' if the memory cap handed
+// the search over to boundedSearch().
+moveset_t
+serialAStar(Cube& cube, bool& bounded);
+
+// Serial A* search helper, adapted from BFS that uses a std::priority_queue instead
+// of a std::queue and returns as soon as a solution is found rather than
+// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic.
+// Returns an empty moveset once the memory cap is reached.
+moveset_t
+serialAStarHelper(frontierAStar_t& frontier, const moveset_t& moves);
+
+// Parallel A* using Hash-Distributed A* (HDA*). Every state is owned by the
+// thread its hash maps to, so each state is expanded at most once across all
+// threads. Generated children are sent to their owner through batched SPSC
+// mailboxes and the search ends once termination detection sees every worker
+// idle with no messages in flight, which makes the returned solution optimal.
+// Reaching the memory cap stops every worker, hands over to boundedSearch()
+// and sets 'bounded'. Runs as a gang of 'p' workers from 'pool'.
+moveset_t
+parallelAStar(Cube& cube, unsigned p, ThreadPool& pool, bool& bounded);
+
+// HDA* worker owning every state whose hash maps to 'tid'. Keeps a private
+// open list and closed table, drains its inbound mailboxes, expands its best
+// node and forwards children it does not own in batches.
+void
+hdaStarWorker(HDAShared& shared, unsigned tid, const Cube& cube, const moveset_t& moves);
+
+// Inserts 'state' into the open list unless the closed table already holds
+// the same cube reached in as few moves.
+void
+hdaAdmit(CubeState&& state, frontierHDA_t& open, closedHDA_t& closed);
+
+// Sends a batch to its owner's mailbox. Returns false and keeps the batch if
+// the mailbox is full.
+bool
+hdaFlush(HDAShared& shared, unsigned from, unsigned to, mailBatch_t& batch);
+
+// Records 'solution' as the incumbent if it is shorter than the current one.
+void
+hdaOfferSolution(HDAShared& shared, const moveset_t& solution);
+
+// Four-counter termination detection over all HDA* workers.
+bool
+hdaTerminated(HDAShared& shared);
+
+// One detection wave. Returns false if any worker is active, otherwise sums
+// the message counters.
+bool
+hdaWave(HDAShared& shared, size_t& sent, size_t& received);
+
+// Thread that owns 'cube' in HDA*.
+unsigned
+hdaOwner(const Cube& cube, unsigned p);
+
+// Budgeted solver that returns the best solution found before 'budgetMs'
+// milliseconds or 'nodeBudget' expansions run out (0 means unlimited). A
+// two-phase search finds a first solution and the peephole optimizer
+// shortens it, then iterative deepening with an admissible bound improves on
+// it until it proves optimality.
+SolveResult
+anytimeSolve(Cube& cube, double budgetMs, size_t nodeBudget);
+
+// First pass of the anytime solver, a two-phase search (see TwoPhase.hpp).
+// Returns the first solution found, or an empty moveset if the budget runs
+// out first. Memory stays proportional to the solution length.
+moveset_t
+anytimeTwoPhasePass(const Cube& cube, SearchBudget& budget);
+
+// Phase one of anytimeTwoPhasePass(): depth-first search for paths of
+// exactly 'maxDepth' moves from 'root' into <U, D, R2, L2, F2, B2>, pruned
+// by CoordTables::phaseOneBound(). Each one is handed to phase two, so this
+// stops at the first complete solution, left in 'path'. 'coords' is the
+// state reached by 'path'.
+DepthResult
+phaseOneSearch(const Cube& root, const CoordState& coords, movecode_t& path, size_t maxDepth,
+               SearchBudget& budget);
+
+// Phase two of anytimeTwoPhasePass(): depth-first search for a solution of
+// the subgroup state 'state', reached by 'path', that leaves 'path' exactly
+// 'maxDepth' moves long.
+DepthResult
+phaseTwoSearch(const PhaseTwoState& state, movecode_t& path, size_t maxDepth, SearchBudget& budget);
+
+// True if move 'code' may follow 'path': not the same face as the last
+// move, and turns of opposite faces only in MOVE_NAMES order.
+bool
+canFollow(uint8_t code, const movecode_t& path);
+
+// Depth-first pass of the anytime solver bounded to 'maxDepth' moves, over
+// the state 'coords' reached by 'path' from 'root'. 'codes' are the move
+// codes of 'moves'. Prunes with CoordTables::lowerBound() so every depth it
+// exhausts is proven empty. The caller guarantees 'coords' is within the
+// bound.
+DepthResult
+anytimeDepthPass(const Cube& root, const CoordState& coords, moveset_t& path, const moveset_t& moves,
+                 const movecode_t& codes, size_t maxDepth, SearchBudget& budget);
+
+// Applies every move allowed after 'path' to 'coords' and records each child
+// with its lower bound.
+void
+expandChildren(const CoordState& coords, const moveset_t& path, const moveset_t& moves, const movecode_t& codes,
+               Expansion& expansion);
+
+// Iterative deepening from 'minDepth' with CoordTables::lowerBound() pruning
+// (IDA*), for searches that reached the memory cap. Memory stays
+// proportional to the solution length. Returns an empty moveset if no
+// solution has at most 'maxDepth' moves.
+moveset_t
+boundedSearch(const Cube& cube, size_t minDepth, size_t maxDepth);
+
+// Shortest solution of 'cube' within the move group 'group' (ru, ruf or
+// half), or within the smallest of them that contains 'cube' for "group".
+// Returns false if no such group contains 'cube'.
+bool
+groupSolve(const Cube& cube, const std::string& group, moveset_t& solution);
+
+// groupSolve() for one group. Returns false if it does not contain 'cube'.
+template<uint32_t MOVES>
+bool
+groupSolveIn(const Cube& cube, moveset_t& solution);
+
+// Returns true if same move is not being done more than once in a row, or when
+// opposite face is moved before it.
+bool
+uniqueMoves(const char face, const moveset_t& solution);
+
+// Returns letter representing opposite face of 'face'
+char
+oppositeFace(const char face);
+
+// Passes 'solution' and every ordering of it that swaps adjacent turns of
+// opposite faces to 'onSolution', counting each in 'count'. Returns false
+// once 'onSolution' asks to stop.
+bool
+passOrderings(const moveset_t& solution, const solutionCallback_t& onSolution, size_t& count);
+
+// Partition calculation used for chunking starting move vector.
+unsigned
+partitionStart(const unsigned p, const unsigned tid);
+
+}
+
+/************************************************/
+
+Solver::Solver(unsigned threads, unsigned requests, bool pin)
+  : m_workers(threads > 0 ? threads : ThreadPool::cpuCount(), pin),
+    m_requests(requests)
+{ }
+
+/************************************************/
+
+// Request threads finish every queued call before the workers stop
+Solver::~Solver()
+{ }
+
+/************************************************/
+
+unsigned
+Solver::threads() const
+{
+  return m_workers.size();
+}
+
+/************************************************/
+
+// True if solve() accepts 'algorithm' as SolveOptions::algorithm
+bool
+Solver::hasAlgorithm(const std::string& algorithm)
+{
+  for (const char* name : { "bfs", "astar", "itdeep", "anytime", "ru", "ruf", "half", "group" })
+    if (algorithm == name)
+      return true;
+
+  return false;
+}
+
+/************************************************/
+
+void
+Solver::prepare(const SolveOptions& options) const
+{
+  // A budgeted "group" solve outside every group runs the anytime solver
+  bool anytime = options.algorithm == "anytime" ||
+                 (options.algorithm == "group" && (options.budgetMs > 0 || options.nodeBudget > 0));
+
+  // Parallel BFS and the anytime solver shorten their solutions
+  if (anytime || (options.threads > 0 && options.algorithm == "bfs"))
+    PeepholeTable::instance();
+
+  if (anytime || options.algorithm == "all" || options.algorithm == "group")
+    CoordTables::instance();
+  if (anytime)
+    PhaseTwoTables::instance();
+
+  if (options.algorithm == "half" || options.algorithm == "group")
+    GroupSolver<GROUP_HALF>::instance();
+  if (options.algorithm == "ru" || options.algorithm == "group")
+    GroupSolver<GROUP_RU>::instance();
+  if (options.algorithm == "ruf" || options.algorithm == "group")
+    GroupSolver<GROUP_RUF>::instance();
+}
+
+/************************************************/
+
+// Runs the algorithm on a copy of 'cube', serially when no threads are
+// requested. Suboptimal parallel BFS results are shortened with
+// optimizeSolution(). Move group solves are always serial.
+SolveResult
+Solver::solve(const Cube& cube, const SolveOptions& options)
+{
+  if (!hasAlgorithm(options.algorithm))
+    throw std::invalid_argument("unknown algorithm: " + options.algorithm);
+
+  Cube copy(cube);
+  if (options.algorithm == "anytime")
+    return anytimeSolve(copy, options.budgetMs, options.nodeBudget);
+
+  SolveResult result;
+  if (options.algorithm == "ru" || options.algorithm == "ruf" || options.algorithm == "half" ||
+      options.algorithm == "group")
+  {
+    // Group solutions are only shortest within their group
+    result.found = groupSolve(cube, options.algorithm, result.solution);
+    if (!result.found && options.algorithm == "group")
+      return solveOutsideGroups(cube, options);
+
+    return result;
+  }
+
+  unsigned p = workersFor(options.threads);
+  if (p == 0)
+  {
+    if (options.algorithm == "bfs")
+      result.solution = serialBFS(copy, result.boundedFallback);
+    else if (options.algorithm == "astar")
+      result.solution = serialAStar(copy, result.boundedFallback);
+    else
+      result.solution = serialID(copy);
+  }
+  // Parallel BFS returns whichever thread finishes first, which is not
+  // always a shortest solution
+  else if (options.algorithm == "bfs")
+    result.solution = optimizeSolution(parallelBFS(copy, p, m_workers, result.boundedFallback));
+  else if (options.algorithm == "astar")
+    result.solution = parallelAStar(copy, p, m_workers, result.boundedFallback);
+  else
+    result.solution = parallelID(copy, p, m_workers);
+
+  result.found = result.solution.size() > 0 || cube.isSolved();
+  return result;
+}
+
+/************************************************/
+
+std::future<SolveResult>
+Solver::solveAsync(const Cube& cube, const SolveOptions& options)
+{
+  return m_requests.submit([this, cube, options] { return solve(cube, options); });
+}
+
+/************************************************/
+
+// Calls 'done' on a request thread once the solve finishes. Throws
+// std::invalid_argument before queuing if the algorithm is unknown, since
+// 'done' could not report it.
+void
+Solver::solveAsync(const Cube& cube, const SolveOptions& options, solveCallback_t done)
+{
+  if (!hasAlgorithm(options.algorithm))
+    throw std::invalid_argument("unknown algorithm: " + options.algorithm);
+
+  m_requests.submit([this, cube, options, done] { done(solve(cube, options)); });
+}
+
+/************************************************/
+
+// Passes every optimal solution of 'cube' to 'onSolution' as it is found,
+// using 'threads' search workers or a serial search when 0. Turns of
+// opposite faces commute, so solutions differing only in their order are
+// passed once, in MOVE_NAMES order, unless 'allOrderings' is set. Returns
+// the number of solutions passed.
+size_t
+Solver::enumerateOptimal(const Cube& cube, unsigned threads, const solutionCallback_t& onSolution,
+                         bool allOrderings)
+{
+  size_t count = 0;
+  auto drain = [&count, &onSolution, allOrderings](auto& enumerator)
+  {
+    moveset_t solution;
+    while (enumerator.next(solution))
+    {
+      if (allOrderings)
+      {
+        if (!passOrderings(solution, onSolution, count))
+          break;
+        continue;
+      }
+
+      ++count;
+      if (!onSolution(solution))
+        break;
+    }
+  };
+
+  unsigned p = workersFor(threads);
+  if (p > 0)
+  {
+    ParallelOptimalEnumerator parallel(cube, p, m_workers);
+    drain(parallel);
+  }
+  else
+  {
+    PerfScope scope("all");
+    OptimalEnumerator serial(cube);
+    drain(serial);
+  }
+
+  return count;
+}
+
+/************************************************/
+
+// Requested worker count clamped to the pool, since a gang cannot be larger
+unsigned
+Solver::workersFor(unsigned requested) const
+{
+  return std::min(requested, m_workers.size());
+}
+
+/************************************************/
+
+// Unrestricted optimal search for a "group" solve outside every group. A
+// budget hands it to the anytime solver, which returns its best solution
+// once the budget runs out. Otherwise the optimal enumerator runs on the
+// requested workers, or serially when none are requested.
+SolveResult
+Solver::solveOutsideGroups(const Cube& cube, const SolveOptions& options)
+{
+  if (options.budgetMs > 0 || options.nodeBudget > 0)
+  {
+    Cube copy(cube);
+    return anytimeSolve(copy, options.budgetMs, options.nodeBudget);
+  }
+
+  SolveResult result;
+  unsigned p = workersFor(options.threads);
+  if (p > 0)
+  {
+    ParallelOptimalEnumerator parallel(cube, p, m_workers);
+    result.found = result.optimal = parallel.next(result.solution);
+  }
+  else
+  {
+    OptimalEnumerator serial(cube);
+    result.found = result.optimal = serial.next(result.solution);
+  }
+
+  return result;
+}
+
+/************************************************/
+
+namespace
+{
+
+// Returns strings representing all start moves based on face names.
+moveset_t
+getStartMoves(const std::string& faceNames)
+{
+  moveset_t moves;
+  std::string variants = "2\'";
+
+  for (const char faceChar : faceNames)
+  {
+    std::string face;
+    face += faceChar;
+    moves.push_back(face);
+
+    for (const char var : variants)
+      moves.push_back(face + var);
+  }
+
+  return moves;
+}
+
+/************************************************/
+
+// Serial Depth-First Search. First level is populated with every possible
+// starting move. Each vertex is one CubeState struct instance with a copy of
+// cube and a solution vector.
+moveset_t
+serialID(Cube& cube)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  frontierID_t frontier;
+
+  for (const auto& move : initMoves)
+  {
+    CubeState state(cube);
+    state.cube.move(move);
+    state.solution.push_back(move);
+
+    if (state.cube.isSolved())
+      return state.solution;
+
+    frontier.push(state);
+  }
+
+  for (size_t i = 2; i <= 20; ++i)
+  {
+    PerfScope scope("depth " + std::to_string(i));
+    frontierID_t frontierCopy = frontier;
+    moveset_t sol = serialIDHelper(frontierCopy, initMoves, i);
+    if (sol.size() > 0)
+      return sol;
+  }
+
+  return moveset_t();
+}
+
+/************************************************/
+
+// Serial Breadth-First search helper that searches all nodes after the inital
+// starting moves. Only adds states to the frontier if the moves don't show
+// they are looping infinitely, saving space. Returns at first found solution,
+// or an empty moveset once the memory cap is reached.
+moveset_t
+serialIDHelper(frontierID_t& frontier, const moveset_t& moves, size_t maxDepth)
+{
+  while (frontier.size() > 0)
+  {
+    auto curr = frontier.top();
+    frontier.pop();
+
+    if (curr.solution.size() < maxDepth) 
+    {
+      ++t_expandedNodes;
+      for (const auto& move : moves)
+      {
+        if (uniqueMoves(move[0], curr.solution))
+        {
+          CubeState copyState(curr);
+          copyState.cube.move(move);
+          copyState.solution.push_back(move);
+          
+          if (copyState.cube.isSolved())
+            return copyState.solution;
+
+          frontier.push(copyState);
+        }
+      }
+    }
+  }
+
+  return moveset_t();
+}
+
+// Parallel iterative deepening. Every depth splits the first moves across a
+// gang of 'p' workers from 'pool'.
+moveset_t
+parallelID(Cube& cube, unsigned p, ThreadPool& pool)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  bool finished = false;
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  CubeState solved;
+
+  for (size_t i = 2; i <= 20; ++i) {
+    std::vector<CubeState> results(p);
+    std::mutex lock;
+    pool.parallel(p, [&](unsigned tid)
+    {
+      frontierID_t frontier;
+      for (unsigned m = partitionStart(p, tid); m < partitionStart(p, tid + 1); ++m)
+      {
+        CubeState state(cube);
+        state.cube.move(initMoves[m]);
+        state.solution.push_back(initMoves[m]);
+
+        frontier.push(state);
+      }
+
+      results[tid] = parallelIDHelper(std::move(frontier), initMoves, finished, lock, i, tid);
+    });
+
+    bool foundSolved = false;
+    for (auto& state : results)
+    {
+      if (!foundSolved && state.solution.size() > 0 && state.cube.isSolved())
+      {
+        foundSolved = true;
+        solved = state;
+      }
+    }
+
+    if (foundSolved)
+      break;
+  }
+  return solved.solution;
+}
+
+CubeState
+parallelIDHelper(frontierID_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, size_t maxDepth, unsigned tid)
+{
+  PerfScope scope("depth " + std::to_string(maxDepth), tid);
+  while (!finished && frontier.size() > 0)
+  {
+    auto curr = frontier.top();
+    frontier.pop();
+    
+    if (curr.solution.size() < maxDepth) 
+    {
+      ++t_expandedNodes;
+      for (const auto& move : moves)
+      {
+        if (uniqueMoves(move[0], curr.solution))
+        {
+          CubeState copyState(curr);
+          copyState.cube.move(move);
+          copyState.solution.push_back(move);      
+          
+          if (!finished && copyState.cube.isSolved())
+          {
+            lock.lock();
+            finished = true;
+            lock.unlock();
+            return copyState;
+          }
+
+          frontier.push(copyState);
+        }
+      }
+    }
+  }
+
+  return CubeState();
+}
+
+/************************************************/
+
+// Serial Breadth-First Search. First level is populated with every possible
+// starting move. Each vertex is one CubeState struct instance with a copy of
+// cube and a solution vector. Sets 'bounded' if the memory cap handed the
+// search over to boundedSearch().
+moveset_t
+serialBFS(Cube& cube, bool& bounded)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  frontierBFS_t frontier;
+
+  for (const auto& move : initMoves)
+  {
+    CubeState state(cube);
+    state.cube.move(move);
+    state.solution.push_back(move);
+
+    if (state.cube.isSolved())
+      return state.solution;
+
+    frontier.push(state);
+  }
+
+  moveset_t solution = serialBFSHelper(frontier, initMoves);
+  if (solution.size() > 0)
+    return solution;
+
+  // Out of memory. Every state as deep as the front of the frontier has
+  // already been checked.
+  size_t minDepth = frontier.front().solution.size() + 1;
+  frontier = frontierBFS_t();
+  bounded = true;
+  return boundedSearch(cube, minDepth, MAX_SOLUTION_DEPTH);
+}
+
+/************************************************/
+
+// Serial Breadth-First search helper that searches all nodes after the inital
+// starting moves. Only adds states to the frontier if the moves don't show
+// they are looping infinitely, saving space. Returns at first found solution,
+// or an empty moveset once the memory cap is reached.
+moveset_t
+serialBFSHelper(frontierBFS_t& frontier, const moveset_t& moves)
+{
+  movecode_t codes = encodeMoves(moves);
+  CubeBatch parents(BFS_BATCH_SIZE), children(BFS_BATCH_SIZE);
+  std::vector<CubeState> chunk;
+  CubeState solved;
+
+  while (!MemoryGovernor::instance().overBudget())
+  {
+    popBFSChunk(frontier, chunk, parents);
+    if (expandBFSChunk(chunk, parents, children, moves, codes, frontier, solved))
+      return solved.solution;
+  }
+
+  return moveset_t();
+}
+
+/************************************************/
+
+// Parallel Breadth-First Search on a gang of 'p' workers from 'pool'. First
+// level is populated with every possible starting move, and partitioned to the
+// workers. Those workers then search their section of the graph until a
+// solution is found by one of them. That solution is returned and all other
+// states are ignored. Sets 'bounded' if the memory cap handed the search over
+// to boundedSearch().
+moveset_t
+parallelBFS(Cube& cube, unsigned p, ThreadPool& pool, bool& bounded)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  bool finished = false;
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+
+  std::vector<CubeState> results(p);
+  std::mutex lock;
+  pool.parallel(p, [&](unsigned tid)
+  {
+    frontierBFS_t frontier;
+    for (unsigned m = partitionStart(p, tid); m < partitionStart(p, tid + 1); ++m)
+    {
+      CubeState state(cube);
+      state.cube.move(initMoves[m]);
+      state.solution.push_back(initMoves[m]);
+
+      frontier.push(state);
+    }
+
+    results[tid] = parallelBFSHelper(std::move(frontier), initMoves, finished, lock, tid);
+  });
+
+  bool foundSolved = false;
+  CubeState solved;
+  size_t minDepth = SIZE_MAX;
+  for (auto& state : results)
+  {
+    if (!foundSolved && state.cube.isSolved())
+    {
+      foundSolved = true;
+      solved = state;
+    }
+
+    minDepth = std::min(minDepth, state.solution.size() + 1);
+  }
+
+  if (foundSolved)
+    return solved.solution;
+
+  // Out of memory. Each thread has checked its part of the graph as deep as
+  // the state it returned.
+  bounded = true;
+  return boundedSearch(cube, minDepth, MAX_SOLUTION_DEPTH);
+}
+/************************************************/
+
+// Parallel Breadth-First search helper where each node searches their section
+// of the graph. Only adds states to the frontier if the moves don't show they
+// are looping infinitely, saving space. Returns once one thread finishes (i.e.
+// solution is at front of local frontier), indicated by the shared bool 'finished',
+// or with an unsolved state once the memory cap is reached.
+CubeState
+parallelBFSHelper(frontierBFS_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, unsigned tid)
+{
+  PerfScope scope("bfs", tid);
+  movecode_t codes = encodeMoves(moves);
+  CubeBatch parents(BFS_BATCH_SIZE), children(BFS_BATCH_SIZE);
+  std::vector<CubeState> chunk;
+  CubeState solved;
+
+  while (!finished && !MemoryGovernor::instance().overBudget())
+  {
+    popBFSChunk(frontier, chunk, parents);
+    if (expandBFSChunk(chunk, parents, children, moves, codes, frontier, solved) && !finished)
+    {
+      lock.lock();
+      finished = true;
+      lock.unlock();
+      return solved;
+    }
+  }
+
+  return frontier.front();
+}
+
+/************************************************/
+
+// Moves up to BFS_BATCH_SIZE states from the front of 'frontier' into
+// 'chunk' and their cubes into 'parents'. Stops at the first state one move
+// deeper, so a chunk never spans two BFS layers.
+void
+popBFSChunk(frontierBFS_t& frontier, std::vector<CubeState>& chunk, CubeBatch& parents)
+{
+  chunk.clear();
+  parents.clear();
+
+  size_t depth = frontier.front().solution.size();
+  while (chunk.size() < BFS_BATCH_SIZE && frontier.size() > 0 && frontier.front().solution.size() == depth)
+  {
+    parents.push(frontier.front().cube);
+    chunk.push_back(std::move(frontier.front()));
+    frontier.pop();
+  }
+}
+
+/************************************************/
+
+// Applies each move to the whole chunk at once and pushes the children that
+// pass uniqueMoves() onto 'frontier'. Returns true with 'solved' set as soon
+// as a child is solved.
+bool
+expandBFSChunk(const std::vector<CubeState>& chunk, const CubeBatch& parents, CubeBatch& children,
+               const moveset_t& moves, const movecode_t& codes, frontierBFS_t& frontier, CubeState& solved)
+{
+  uint8_t solvedMask[BFS_BATCH_SIZE];
+  t_expandedNodes += chunk.size();
+
+  for (size_t m = 0; m < moves.size(); ++m)
+  {
+    children.assignTurned(parents, codeFace(codes[m]), codeTurns(codes[m]));
+    children.solvedMask(solvedMask);
+
+    for (size_t c = 0; c < chunk.size(); ++c)
+    {
+      if (!uniqueMoves(moves[m][0], chunk[c].solution))
+        continue;
+
+      CubeState child(children.get(c));
+      child.solution.reserve(chunk[c].solution.size() + 1);
+      child.solution = chunk[c].solution;
+      child.solution.push_back(moves[m]);
+
+      if (solvedMask[c])
+      {
+        solved = std::move(child);
+        return true;
+      }
+
+      frontier.push(std::move(child));
+    }
+  }
+
+  return false;
+}
+
+/************************************************/
+
+// Serial A* adapted from BFS. Sets 'bounded' if the memory cap handed the
+// search over to boundedSearch().
+moveset_t
+serialAStar(Cube& cube, bool& bounded)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  frontierAStar_t frontier;
+
+  for (const auto& move : initMoves)
+  {
+    CubeState state(cube);
+    state.cube.move(move);
+    state.solution.push_back(move);
+    
+    if (state.cube.isSolved())
+      return state.solution;
+
+    frontier.push(state);
+  }
+
+  moveset_t solution = serialAStarHelper(frontier, initMoves);
+  if (solution.size() > 0)
+    return solution;
+
+  // Out of memory. The heuristic ordering proves no depth, so the bounded
+  // search starts from the cube's own bound.
+  frontier = frontierAStar_t();
+  bounded = true;
+  return boundedSearch(cube, 0, MAX_SOLUTION_DEPTH);
+}
+
+/************************************************/
+
+// Serial A* search helper, adapted from BFS that uses a std::priority_queue instead
+// of a std::queue and returns as soon as a solution is found rather than
+// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic.
+// Returns an empty moveset once the memory cap is reached.
+moveset_t
+serialAStarHelper(frontierAStar_t& frontier, const moveset_t& moves)
+{
+  frontierAStar_t temp;
+  while (!frontier.top().cube.isSolved())
+  {
+    if (MemoryGovernor::instance().overBudget() || !temp.hasRoom(moves.size()))
+      return moveset_t();
+
+    ++t_expandedNodes;
+
+    for (const auto& move : moves)
+    {
+      if (uniqueMoves(move[0], frontier.top().solution))
+      {
+        CubeState copyState(frontier.top());
+        copyState.cube.move(move);
+        copyState.solution.push_back(move);
+        
+        if (copyState.cube.isSolved())
+          return copyState.solution;
+
+        temp.push(copyState);
+      }
+    }
+    
+    frontier.pop();
+    if (frontier.size() == 0)
+    {
+      frontier = std::move(temp);
+      temp = frontierAStar_t();
+    }
+  }
+
+  return frontier.top().solution;
+}
+
+/************************************************/
+
+// Parallel A* using Hash-Distributed A* (HDA*). Every state is owned by the
+// thread its hash maps to, so each state is expanded at most once across all
+// threads. Generated children are sent to their owner through batched SPSC
+// mailboxes and the search ends once termination detection sees every worker
+// idle with no messages in flight, which makes the returned solution optimal.
+// Reaching the memory cap stops every worker, hands over to boundedSearch()
+// and sets 'bounded'. Runs as a gang of 'p' workers from 'pool'.
+moveset_t
+parallelAStar(Cube& cube, unsigned p, ThreadPool& pool, bool& bounded)
+{
+  if (cube.isSolved())
+    return moveset_t();
+
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  moveset_t best;
+  bool outOfMemory;
+  {
+    HDAShared shared(p);
+    pool.parallel(p, [&](unsigned tid) { hdaStarWorker(shared, tid, cube, initMoves); });
+
+    best = shared.best;
+    outOfMemory = shared.outOfMemory.load();
+  }
+
+  if (!outOfMemory)
+    return best;
+
+  // Out of memory, with open lists and mailboxes freed. Workers expand in f
+  // order only locally, so no depth is proven, but an incumbent caps it.
+  bounded = true;
+  moveset_t shorter = boundedSearch(cube, 0, best.size() > 0 ? best.size() - 1 : MAX_SOLUTION_DEPTH);
+  return shorter.size() > 0 ? shorter : best;
+}
+
+/************************************************/
+
+// HDA* worker owning every state whose hash maps to 'tid'. Keeps a private
+// open list and closed table, drains its inbound mailboxes, expands its best
+// node and forwards children it does not own in batches.
+void
+hdaStarWorker(HDAShared& shared, unsigned tid, const Cube& cube, const moveset_t& moves)
+{
+  frontierHDA_t open;
+  closedHDA_t closed;
+  std::vector<mailBatch_t> outbox(shared.p);
+  HDAWorkerStatus& status = shared.status[tid];
+  PerfScope scope("hda*", tid);
+
+  if (hdaOwner(cube, shared.p) == tid)
+    hdaAdmit(CubeState(cube), open, closed);
+
+  bool full = false;
+  while (!shared.terminate.load(std::memory_order_acquire))
+  {
+    if (full || MemoryGovernor::instance().overBudget() || !open.hasRoom(moves.size()))
+    {
+      shared.outOfMemory.store(true);
+      shared.terminate.store(true, std::memory_order_release);
+      break;
+    }
+
+    for (unsigned from = 0; from < shared.p && !full; ++from)
+    {
+      mailBatch_t batch;
+      while (shared.mailbox(from, tid).pop(batch))
+      {
+        // A batch that cannot be admitted under the cap is dropped, since
+        // the search is about to stop anyway
+        full = !open.hasRoom(batch.size());
+        if (full)
+          break;
+
+        // Go active before counting the receipt so a detection wave never
+        // sees this batch as consumed while the worker still looks idle.
+        status.idle.store(false, std::memory_order_seq_cst);
+        status.received.fetch_add(1, std::memory_order_seq_cst);
+
+        for (auto& state : batch)
+          hdaAdmit(std::move(state), open, closed);
+      }
+    }
+
+    if (full)
+      continue;
+
+    size_t bestLength = shared.bestLength.load(std::memory_order_acquire);
+    if (open.size() > 0 && HDACompare::f(open.top()) < bestLength)
+    {
+      status.idle.store(false, std::memory_order_seq_cst);
+
+      CubeState curr = open.top();
+      open.pop();
+
+      // Skip entries superseded by a cheaper path to the same state
+      if (closed[curr.cube] < curr.solution.size())
+        continue;
+      ++t_expandedNodes;
+
+      for (const auto& move : moves)
+      {
+        if (curr.solution.size() == 0 || uniqueMoves(move[0], curr.solution))
+        {
+          CubeState copyState(curr);
+          copyState.cube.move(move);
+          copyState.solution.push_back(move);
+
+          if (copyState.cube.isSolved())
+          {
+            hdaOfferSolution(shared, copyState.solution);
+            continue;
+          }
+
+          if (HDACompare::f(copyState) >= shared.bestLength.load(std::memory_order_relaxed))
+            continue;
+
+          unsigned owner = hdaOwner(copyState.cube, shared.p);
+          if (owner == tid)
+            hdaAdmit(std::move(copyState), open, closed);
+          else
+          {
+            outbox[owner].push_back(std::move(copyState));
+            if (outbox[owner].size() >= HDA_BATCH_SIZE)
+              hdaFlush(shared, tid, owner, outbox[owner]);
+          }
+        }
+      }
+
+      continue;
+    }
+
+    // No useful local work left. Only go idle once every outbound batch has
+    // been delivered, otherwise work could be lost to termination.
+    bool flushed = true;
+    for (unsigned to = 0; to < shared.p; ++to)
+      if (outbox[to].size() > 0 && !hdaFlush(shared, tid, to, outbox[to]))
+        flushed = false;
+
+    if (!flushed)
+      continue;
+
+    status.idle.store(true, std::memory_order_seq_cst);
+    if (tid == 0 && hdaTerminated(shared))
+      shared.terminate.store(true, std::memory_order_release);
+    else
+      std::this_thread::yield();
+  }
+}
+
+/************************************************/
+
+// Inserts 'state' into the open list unless the closed table already holds
+// the same cube reached in as few moves.
+void
+hdaAdmit(CubeState&& state, frontierHDA_t& open, closedHDA_t& closed)
+{
+  auto it = closed.find(state.cube);
+  if (it != closed.end() && it->second <= state.solution.size())
+    return;
+
+  closed[state.cube] = state.solution.size();
+  open.push(std::move(state));
+}
+
+/************************************************/
+
+// Sends a batch to its owner's mailbox. Returns false and keeps the batch if
+// the mailbox is full.
+bool
+hdaFlush(HDAShared& shared, unsigned from, unsigned to, mailBatch_t& batch)
+{
+  // Count the send before publishing so sent >= received always holds
+  HDAWorkerStatus& status = shared.status[from];
+  status.sent.fetch_add(1, std::memory_order_seq_cst);
+  if (!shared.mailbox(from, to).push(batch))
+  {
+    status.sent.fetch_sub(1, std::memory_order_seq_cst);
+    return false;
+  }
+
+  batch = mailBatch_t();
+  return true;
+}
+
+/************************************************/
+
+// Records 'solution' as the incumbent if it is shorter than the current one.
+void
+hdaOfferSolution(HDAShared& shared, const moveset_t& solution)
+{
+  std::lock_guard<std::mutex> guard(shared.lock);
+  if (solution.size() < shared.bestLength.load(std::memory_order_relaxed))
+  {
+    shared.best = solution;
+    shared.bestLength.store(solution.size(), std::memory_order_release);
+  }
+}
+
+/************************************************/
+
+// Four-counter termination detection. Two consecutive waves must both see
+// every worker idle and the same, balanced totals of sent and received
+// batches. A worker only leaves idle by receiving a batch, which changes the
+// received total, so matching waves mean no work exists anywhere.
+bool
+hdaTerminated(HDAShared& shared)
+{
+  size_t sent1, received1, sent2, received2;
+  if (!hdaWave(shared, sent1, received1) || sent1 != received1)
+    return false;
+
+  if (!hdaWave(shared, sent2, received2))
+    return false;
+
+  return sent1 == sent2 && received1 == received2 && sent2 == received2;
+}
+
+/************************************************/
+
+// One detection wave. Returns false if any worker is active, otherwise sums
+// the message counters.
+bool
+hdaWave(HDAShared& shared, size_t& sent, size_t& received)
+{
+  for (unsigned tid = 0; tid < shared.p; ++tid)
+    if (!shared.status[tid].idle.load(std::memory_order_seq_cst))
+      return false;
+
+  sent = received = 0;
+  for (unsigned tid = 0; tid < shared.p; ++tid)
+  {
+    sent += shared.status[tid].sent.load(std::memory_order_seq_cst);
+    received += shared.status[tid].received.load(std::memory_order_seq_cst);
+  }
+
+  return true;
+}
+
+/************************************************/
+
+// Thread that owns 'cube' in HDA*.
+unsigned
+hdaOwner(const Cube& cube, unsigned p)
+{
+  return cube.hash() % p;
+}
+
+/************************************************/
+
+// Budgeted solver that returns the best solution found before 'budgetMs'
+// milliseconds or 'nodeBudget' expansions run out (0 means unlimited). A
+// two-phase search finds a first solution and the peephole optimizer
+// shortens it, then iterative deepening with an admissible bound improves on
+// it until it proves optimality.
+SolveResult
+anytimeSolve(Cube& cube, double budgetMs, size_t nodeBudget)
+{
+  SolveResult result;
+  if (cube.isSolved())
+  {
+    result.found = true;
+    result.optimal = true;
+    return result;
+  }
+
+  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  Deadline deadline(budgetMs);
+
+  // The first pass only gets half of each budget so that improvement always
+  // has time left to run. A limit never halves to 0, which would lift it.
+  Deadline firstDeadline(budgetMs > 0 ? std::max(budgetMs / 2, std::numeric_limits<double>::min()) : 0);
+  SearchBudget firstBudget(firstDeadline, nodeBudget > 0 ? std::max<size_t>(1, nodeBudget / 2) : 0);
+  {
+    PerfScope scope("two-phase");
+    result.solution = optimizeSolution(anytimeTwoPhasePass(cube, firstBudget));
+  }
+  result.found = result.solution.size() > 0;
+
+  SearchBudget budget(deadline, nodeBudget);
+  budget.expanded = firstBudget.expanded;
+
+  const CoordTables& tables = CoordTables::instance();
+  CoordState coords = tables.fromCube(cube);
+  movecode_t initCodes = encodeMoves(initMoves);
+
+  size_t maxDepth = result.found ? result.solution.size() - 1 : 20;
+  size_t minDepth = std::max((unsigned) cube.movesLowerBound(), tables.lowerBound(coords));
+  for (size_t depth = std::max((size_t) 1, minDepth); depth <= maxDepth; ++depth)
+  {
+    PerfScope scope("depth " + std::to_string(depth));
+    moveset_t path;
+    DepthResult depthResult = anytimeDepthPass(cube, coords, path, initMoves, initCodes, depth, budget);
+    if (depthResult == DepthResult::OUT_OF_BUDGET)
+    {
+      result.expanded = budget.expanded;
+      return result;
+    }
+
+    if (depthResult == DepthResult::FOUND)
+    {
+      result.solution = path;
+      result.found = true;
+      break;
+    }
+  }
+
+  // Every depth below the returned solution was exhausted
+  result.optimal = result.found;
+  result.expanded = budget.expanded;
+  return result;
+}
+
+/************************************************/
+
+// First pass of the anytime solver, a two-phase search (see TwoPhase.hpp).
+// Returns the first solution found, or an empty moveset if the budget runs
+// out first. Memory stays proportional to the solution length.
+moveset_t
+anytimeTwoPhasePass(const Cube& cube, SearchBudget& budget)
+{
+  const CoordTables& tables = CoordTables::instance();
+  CoordState coords = tables.fromCube(cube);
+
+  // Phase two always finishes within its diameter, so the first way into
+  // the subgroup gives the solution
+  movecode_t path;
+  for (size_t depth = tables.phaseOneBound(coords); depth <= MAX_PHASE_ONE_DEPTH; ++depth)
+  {
+    DepthResult depthResult = phaseOneSearch(cube, coords, path, depth, budget);
+    if (depthResult == DepthResult::FOUND)
+      return decodeMoves(path);
+    if (depthResult == DepthResult::OUT_OF_BUDGET)
+      break;
+  }
+
+  return moveset_t();
+}
+
+/************************************************/
+
+// Phase one of anytimeTwoPhasePass(): depth-first search for paths of
+// exactly 'maxDepth' moves from 'root' into <U, D, R2, L2, F2, B2>, pruned
+// by CoordTables::phaseOneBound(). Each one is handed to phase two, so this
+// stops at the first complete solution, left in 'path'. 'coords' is the
+// state reached by 'path'.
+DepthResult
+phaseOneSearch(const Cube& root, const CoordState& coords, movecode_t& path, size_t maxDepth,
+               SearchBudget& budget)
+{
+  const CoordTables& tables = CoordTables::instance();
+  if (path.size() == maxDepth)
+  {
+    Cube cube(root);
+    for (uint8_t code : path)
+      cube.turn(codeFace(code), codeTurns(code));
+
+    const PhaseTwoTables& phaseTwo = PhaseTwoTables::instance();
+    PhaseTwoState state = phaseTwo.fromCube(cube);
+    for (size_t depth = phaseTwo.lowerBound(state); depth <= MAX_PHASE_TWO_DEPTH; ++depth)
+    {
+      DepthResult depthResult = phaseTwoSearch(state, path, maxDepth + depth, budget);
+      if (depthResult != DepthResult::EXHAUSTED)
+        return depthResult;
+    }
+
+    return DepthResult::EXHAUSTED;
+  }
+
+  if (budget.exhausted())
+    return DepthResult::OUT_OF_BUDGET;
+  ++budget.expanded;
+  ++t_expandedNodes;
+
+  for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+  {
+    if (!canFollow(code, path))
+      continue;
+
+    CoordState child = tables.move(coords, code);
+    if (path.size() + 1 + tables.phaseOneBound(child) > maxDepth)
+      continue;
+
+    path.push_back(code);
+    DepthResult childResult = phaseOneSearch(root, child, path, maxDepth, budget);
+    if (childResult != DepthResult::EXHAUSTED)
+      return childResult;
+    path.pop_back();
+  }
+
+  return DepthResult::EXHAUSTED;
+}
+
+/************************************************/
+
+// Phase two of anytimeTwoPhasePass(): depth-first search for a solution of
+// the subgroup state 'state', reached by 'path', that leaves 'path' exactly
+// 'maxDepth' moves long.
+DepthResult
+phaseTwoSearch(const PhaseTwoState& state, movecode_t& path, size_t maxDepth, SearchBudget& budget)
+{
+  const PhaseTwoTables& tables = PhaseTwoTables::instance();
+  if (path.size() == maxDepth)
+    return tables.lowerBound(state) == 0 ? DepthResult::FOUND : DepthResult::EXHAUSTED;
+
+  if (budget.exhausted())
+    return DepthResult::OUT_OF_BUDGET;
+  ++budget.expanded;
+  ++t_expandedNodes;
+
+  for (unsigned m = 0; m < PHASE_TWO_MOVE_COUNT; ++m)
+  {
+    if (!canFollow(tables.code(m), path))
+      continue;
+
+    PhaseTwoState child = tables.move(state, m);
+    if (path.size() + 1 + tables.lowerBound(child) > maxDepth)
+      continue;
+
+    path.push_back(tables.code(m));
+    DepthResult childResult = phaseTwoSearch(child, path, maxDepth, budget);
+    if (childResult != DepthResult::EXHAUSTED)
+      return childResult;
+    path.pop_back();
+  }
+
+  return DepthResult::EXHAUSTED;
+}
+
+/************************************************/
+
+// True if move 'code' may follow 'path': not the same face as the last
+// move, and turns of opposite faces only in MOVE_NAMES order.
+bool
+canFollow(uint8_t code, const movecode_t& path)
+{
+  if (path.size() == 0)
+    return true;
+
+  unsigned face = codeFace(code), prev = codeFace(path.back());
+  return face != prev && !(prev == oppositeFaceIndex(face) && face < prev);
+}
+
+/************************************************/
+
+// Depth-first pass of the anytime solver bounded to 'maxDepth' moves, over
+// the state 'coords' reached by 'path' from 'root'. 'codes' are the move
+// codes of 'moves'. Prunes with CoordTables::lowerBound() so every depth it
+// exhausts is proven empty. The caller guarantees 'coords' is within the
+// bound.
+DepthResult
+anytimeDepthPass(const Cube& root, const CoordState& coords, moveset_t& path, const moveset_t& moves,
+                 const movecode_t& codes, size_t maxDepth, SearchBudget& budget)
+{
+  // The coordinates leave edge permutation out, so a zero bound is only a
+  // candidate until the cube is rebuilt and checked
+  if (CoordTables::instance().lowerBound(coords) == 0)
+  {
+    Cube cube(root);
+    for (const auto& m : path)
+      cube.move(m);
+    if (cube.isSolved())
+      return DepthResult::FOUND;
+  }
+
+  if (budget.exhausted())
+    return DepthResult::OUT_OF_BUDGET;
+  ++budget.expanded;
+  ++t_expandedNodes;
+
+  // First pass generates every allowed child and bounds it, so the bound
+  // evaluations run back to back instead of interleaved with the recursion.
+  // Children the bound rules out are never copied into 'path' or visited.
+  Expansion expansion;
+  expandChildren(coords, path, moves, codes, expansion);
+
+  for (unsigned i = 0; i < expansion.count; ++i)
+  {
+    if (path.size() + 1 + expansion.bounds[i] > maxDepth)
+      continue;
+
+    path.push_back(moves[expansion.moves[i]]);
+
+    DepthResult childResult = anytimeDepthPass(root, expansion.children[i], path, moves, codes, maxDepth, budget);
+    if (childResult != DepthResult::EXHAUSTED)
+      return childResult;
+
+    path.pop_back();
+  }
+
+  return DepthResult::EXHAUSTED;
+}
+
+/************************************************/
+
+// Applies every move allowed after 'path' to 'coords' and records each child
+// with its lower bound.
+void
+expandChildren(const CoordState& coords, const moveset_t& path, const moveset_t& moves, const movecode_t& codes,
+               Expansion& expansion)
+{
+  const CoordTables& tables = CoordTables::instance();
+
+  expansion.count = 0;
+  for (unsigned m = 0; m < moves.size(); ++m)
+  {
+    if (path.size() == 0 || uniqueMoves(moves[m][0], path))
+    {
+      expansion.children[expansion.count] = tables.move(coords, codes[m]);
+      expansion.moves[expansion.count] = m;
+      ++expansion.count;
+    }
+  }
+
+  for (unsigned i = 0; i < expansion.count; ++i)
+    expansion.bounds[i] = tables.lowerBound(expansion.children[i]);
+}
+
+/************************************************/
+
+// Iterative deepening from 'minDepth' with CoordTables::lowerBound() pruning
+// (IDA*), for searches that reached the memory cap. Memory stays
+// proportional to the solution length. Returns an empty moveset if no
+// solution has at most 'maxDepth' moves.
+moveset_t
+boundedSearch(const Cube& cube, size_t minDepth, size_t maxDepth)
+{
+  minDepth = std::max(minDepth, (size_t) cube.movesLowerBound());
+
+  movecode_t allMoves;
+  for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+    allMoves.push_back(code);
+
+  moveset_t solution;
+  for (size_t depth = minDepth; depth <= maxDepth; ++depth)
+  {
+    PerfScope scope("bounded " + std::to_string(depth));
+    OptimalEnumerator enumerator(cube, depth, allMoves);
+    if (enumerator.next(solution))
+      return solution;
+  }
+
+  return moveset_t();
+}
+
+/************************************************/
+
+// Shortest solution of 'cube' within the move group 'group' (ru, ruf or
+// half), or within the smallest of them that contains 'cube' for "group".
+// Returns false if no such group contains 'cube'.
+bool
+groupSolve(const Cube& cube, const std::string& group, moveset_t& solution)
+{
+  if (group == "half")
+    return groupSolveIn<GROUP_HALF>(cube, solution);
+  else if (group == "ru")
+    return groupSolveIn<GROUP_RU>(cube, solution);
+  else if (group == "ruf")
+    return groupSolveIn<GROUP_RUF>(cube, solution);
+
+  // Fewest moves first, so the search has the smallest branching factor
+  return groupSolveIn<GROUP_HALF>(cube, solution) || groupSolveIn<GROUP_RU>(cube, solution) ||
+         groupSolveIn<GROUP_RUF>(cube, solution);
+}
+
+/************************************************/
+
+// groupSolve() for one group. Returns false if it does not contain 'cube'.
+template<uint32_t MOVES>
+bool
+groupSolveIn(const Cube& cube, moveset_t& solution)
+{
+  return GroupSolver<MOVES>::instance().solve(cube, solution);
+}
+
+/************************************************/
+
+// Returns true if same move is not being done more than once in a row, or when
+// opposite face is moved before it.
+bool
+uniqueMoves(const char face, const moveset_t& solution)
+{
+  return (face != solution.back()[0] && !(solution.size() >= 3 && face == solution[solution.size() - 3][0] && 
+      solution[solution.size() - 2][0] == oppositeFace(face)));
+}
+
+/************************************************/
+
+// Returns letter representing opposite face of 'face'
+char
+oppositeFace(const char face)
+{
+  switch (face)
+  {
+    case 'U':
+      return 'D';
+    case 'D':
+      return 'U';
+    case 'R':
+      return 'L';
+    case 'L':
+      return 'R';
+    case 'F':
+      return 'B';
+    default:
+      return 'F';
+  }
+}
+
+/************************************************/
+
+// Passes 'solution' and every ordering of it that swaps adjacent turns of
+// opposite faces to 'onSolution', counting each in 'count'. Returns false
+// once 'onSolution' asks to stop.
+bool
+passOrderings(const moveset_t& solution, const solutionCallback_t& onSolution, size_t& count)
+{
+  // A canonical solution never turns three opposite faces in a row, so the
+  // commuting pairs do not overlap and each can be swapped independently
+  std::vector<size_t> pairs;
+  for (size_t i = 0; i + 1 < solution.size(); ++i)
+    if (solution[i + 1][0] == oppositeFace(solution[i][0]))
+      pairs.push_back(i++);
+
+  for (size_t mask = 0; mask < ((size_t) 1 << pairs.size()); ++mask)
+  {
+    moveset_t ordering(solution);
+    for (size_t j = 0; j < pairs.size(); ++j)
+      if (mask & ((size_t) 1 << j))
+        std::swap(ordering[pairs[j]], ordering[pairs[j] + 1]);
+
+    ++count;
+    if (!onSolution(ordering))
+      return false;
+  }
+
+  return true;
+}
+
+/************************************************/
+
+// Partition calculation used for chunking starting move vector.
+unsigned
+partitionStart(const unsigned p, const unsigned tid)
+{
+  return START_MOVE_COUNT * tid / p;
+}
+
+}
@@ -0,0 +1,142 @@
+/*
+ * Sean Malloy
+ * Solver.hpp
+ * Library interface to the search algorithms (libcubesolver.a). A Solver
+ * owns a persistent pool of search workers, optionally pinned, that every
+ * parallel search reuses, plus request threads for asynchronous calls. All
+ * of its methods may be called concurrently from any number of threads.
+ *
+ * The lookup tables (PeepholeTable, CoordTables) are immutable once built
+ * and shared by every Solver in the process. prepare() builds the ones a
+ * kind of request needs ahead of time.
+ */
+
+#ifndef SOLVER_HPP
+#define SOLVER_HPP
+
+/************************************************/
+// System includes
+#include <functional>
+#include <future>
+#include <string>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "ThreadPool.hpp"
+
+/************************************************/
+
+struct SolveOptions
+{
+  SolveOptions()
+    : algorithm("astar"),
+      threads(0),
+      budgetMs(0),
+      nodeBudget(0)
+  { }
+
+  // bfs, astar, itdeep or anytime, or a move group to solve in: ru (<R,U>),
+  // ruf (<R,U,F>), half (half turns only) or group (the smallest of those
+  // containing the cube, else an unrestricted search with 'threads' and the
+  // budgets below)
+  std::string algorithm;
+  // Search workers to use, 0 for the serial version. Clamped to the pool size.
+  unsigned threads;
+  // Anytime and group only, 0 for no limit
+  double budgetMs;
+  size_t nodeBudget;
+};
+
+// Result of a solve. 'optimal' is only set once every shorter depth has been
+// exhausted, so an unproven solution may still happen to be optimal. 'found'
+// is also set for the empty solution of a solved cube. 'boundedFallback' is
+// set when BFS or A* reached the memory cap and finished with bounded-memory
+// iterative deepening.
+struct SolveResult
+{
+  SolveResult()
+    : solution(),
+      found(false),
+      optimal(false),
+      boundedFallback(false),
+      expanded(0)
+  { }
+
+  moveset_t solution;
+  bool found;
+  bool optimal;
+  bool boundedFallback;
+  size_t expanded;
+};
+
+typedef std::function<void(const SolveResult&)> solveCallback_t;
+
+// Receives each optimal solution; returning false stops the enumeration
+typedef std::function<bool(const moveset_t&)> solutionCallback_t;
+
+/************************************************/
+
+class Solver
+{
+public:
+  // 'threads' search workers, one per allowed CPU if 0, and pinned to those
+  // CPUs in order if 'pin' is set. 'requests' threads run the asynchronous
+  // calls; each of those runs its serial searches itself and takes search
+  // workers for parallel ones.
+  explicit Solver(unsigned threads = 0, unsigned requests = 1, bool pin = false);
+
+  Solver(const Solver&) = delete;
+  Solver& operator=(const Solver&) = delete;
+
+  // Waits for every pending asynchronous call
+  ~Solver();
+
+  // Number of search workers
+  unsigned
+  threads() const;
+
+  // True if solve() accepts 'algorithm' as SolveOptions::algorithm
+  static bool
+  hasAlgorithm(const std::string& algorithm);
+
+  // Builds the lookup tables a solve with 'options' uses, so the first such
+  // solve does not pay for them
+  void
+  prepare(const SolveOptions& options) const;
+
+  // Throws std::invalid_argument if hasAlgorithm() rejects the algorithm
+  SolveResult
+  solve(const Cube& cube, const SolveOptions& options);
+
+  // The future rethrows anything solve() throws
+  std::future<SolveResult>
+  solveAsync(const Cube& cube, const SolveOptions& options);
+
+  // Calls 'done' on a request thread once the solve finishes. Throws
+  // std::invalid_argument before queuing if the algorithm is unknown.
+  void
+  solveAsync(const Cube& cube, const SolveOptions& options, solveCallback_t done);
+
+  // Passes every optimal solution of 'cube' to 'onSolution' as it is found,
+  // using 'threads' search workers or a serial search when 0. Turns of
+  // opposite faces commute, so solutions differing only in their order are
+  // passed once, in MOVE_NAMES order, unless 'allOrderings' is set. Returns
+  // the number of solutions passed.
+  size_t
+  enumerateOptimal(const Cube& cube, unsigned threads, const solutionCallback_t& onSolution,
+                   bool allOrderings = false);
+
+private:
+  unsigned
+  workersFor(unsigned requested) const;
+
+  // Unrestricted optimal search for a "group" solve outside every group
+  SolveResult
+  solveOutsideGroups(const Cube& cube, const SolveOptions& options);
+
+  ThreadPool m_workers;
+  ThreadPool m_requests;
+};
+
+#endif
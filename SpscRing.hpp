@@ -0,0 +1,87 @@
+/*
+ * Sean Malloy
+ * SpscRing.hpp
+ * Bounded lock-free single-producer/single-consumer ring buffer used as a
+ * mailbox between search threads.
+ */
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+/************************************************/
+// System includes
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/************************************************/
+
+// Exactly one thread may call push() and exactly one other thread may call
+// pop(). Capacity is rounded up to a power of two so indices wrap with a mask.
+template<typename T>
+class SpscRing
+{
+public:
+  explicit SpscRing(size_t capacity = 64)
+    : m_slots(roundUp(capacity)),
+      m_mask(m_slots.size() - 1),
+      m_head(0),
+      m_tail(0)
+  { }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Producer side. Returns false without consuming 'item' if the ring is full.
+  bool
+  push(T& item)
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+      return false;
+
+    m_slots[tail & m_mask] = std::move(item);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the ring is empty.
+  bool
+  pop(T& item)
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire))
+      return false;
+
+    item = std::move(m_slots[head & m_mask]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool
+  empty() const
+  {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  static size_t
+  roundUp(size_t n)
+  {
+    size_t size = 1;
+    while (size < n)
+      size <<= 1;
+    return size;
+  }
+
+  std::vector<T> m_slots;
+  size_t m_mask;
+
+  // Producer and consumer indices live on separate cache lines so the two
+  // threads do not false-share.
+  alignas(64) std::atomic<size_t> m_head;
+  alignas(64) std::atomic<size_t> m_tail;
+};
+
+#endif
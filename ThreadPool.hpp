@@ -0,0 +1,281 @@
+/*
+ * Sean Malloy
+ * ThreadPool.hpp
+ * Persistent worker threads, created once and reused by every request, so
+ * a parallel search pays no thread creation or teardown.
+ *
+ * Besides single tasks the pool runs gangs: n copies of a function that are
+ * guaranteed to run at the same time on n different threads. Parallel
+ * searches whose workers wait on each other (HDA* termination detection,
+ * the bounded solution queue of the enumerator) need that guarantee. A gang
+ * only starts once n threads are free and reserved for it, so concurrent
+ * gangs can never deadlock by each holding part of the pool.
+ */
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+/************************************************/
+// System includes
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/************************************************/
+
+class ThreadPool
+{
+  struct Gang
+  {
+    Gang(unsigned n, std::function<void(unsigned)> f)
+      : size(n),
+        fn(std::move(f)),
+        remaining(n),
+        error(),
+        done()
+    { }
+
+    unsigned size;
+    std::function<void(unsigned)> fn;
+    unsigned remaining;
+    std::exception_ptr error;
+    std::promise<void> done;
+  };
+
+  // One reserved gang member waiting for a thread
+  struct Member
+  {
+    std::shared_ptr<Gang> gang;
+    unsigned index;
+  };
+
+public:
+  // Starts 'threads' workers (at least one). With 'pin' set, worker i is
+  // bound to the i-th CPU (modulo cpuCount()) of the creating thread's
+  // affinity mask, so CPUs excluded by taskset or a cgroup are never used.
+  explicit ThreadPool(unsigned threads, bool pin = false)
+    : m_threads(),
+      m_tasks(),
+      m_gangs(),
+      m_members(),
+      m_free(threads > 0 ? threads : 1),
+      m_stop(false),
+      m_lock(),
+      m_wake()
+  {
+    unsigned count = m_free;
+    for (unsigned id = 0; id < count; ++id)
+      m_threads.emplace_back(&ThreadPool::worker, this, id, pin);
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Finishes every queued task and gang, then joins the workers
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& t : m_threads)
+      t.join();
+  }
+
+  unsigned
+  size() const
+  {
+    return m_threads.size();
+  }
+
+  // CPUs the calling thread may run on, at least one
+  static unsigned
+  cpuCount()
+  {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0)
+      return CPU_COUNT(&allowed);
+#endif
+    unsigned cpus = std::thread::hardware_concurrency();
+    return cpus > 0 ? cpus : 1;
+  }
+
+  // Runs 'task' on the next free worker
+  template<typename F>
+  auto
+  submit(F task) -> std::future<decltype(task())>
+  {
+    typedef decltype(task()) result_t;
+    auto packaged = std::make_shared<std::packaged_task<result_t()>>(std::move(task));
+    std::future<result_t> result = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_tasks.emplace_back([packaged] { (*packaged)(); });
+    }
+    m_wake.notify_one();
+
+    return result;
+  }
+
+  // Runs fn(0) .. fn(n - 1) concurrently on 'n' workers. The future becomes
+  // ready once all of them have returned and rethrows the first exception
+  // any of them threw. 'n' must not exceed size().
+  std::future<void>
+  runGang(unsigned n, std::function<void(unsigned)> fn)
+  {
+    if (n == 0 || n > size())
+      throw std::invalid_argument("gang size must be between 1 and the pool size");
+
+    auto gang = std::make_shared<Gang>(n, std::move(fn));
+    std::future<void> result = gang->done.get_future();
+    {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_gangs.push_back(gang);
+      schedule();
+    }
+    m_wake.notify_all();
+
+    return result;
+  }
+
+  // Blocking form of runGang()
+  void
+  parallel(unsigned n, std::function<void(unsigned)> fn)
+  {
+    runGang(n, std::move(fn)).get();
+  }
+
+private:
+  // Reserves free threads for waiting gangs, oldest first. Called with the
+  // lock held.
+  void
+  schedule()
+  {
+    while (m_gangs.size() > 0 && m_free >= m_gangs.front()->size)
+    {
+      std::shared_ptr<Gang> gang = m_gangs.front();
+      m_gangs.pop_front();
+
+      m_free -= gang->size;
+      for (unsigned i = 0; i < gang->size; ++i)
+        m_members.push_back({ gang, i });
+    }
+  }
+
+  void
+  worker(unsigned id, bool pin)
+  {
+#ifdef __linux__
+    // A new thread inherits its creator's mask
+    cpu_set_t allowed;
+    if (pin && sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0)
+    {
+      unsigned skip = id % CPU_COUNT(&allowed);
+      for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+      {
+        if (!CPU_ISSET(cpu, &allowed) || skip-- > 0)
+          continue;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        break;
+      }
+    }
+#else
+    (void) id;
+    (void) pin;
+#endif
+
+    std::unique_lock<std::mutex> guard(m_lock);
+    for (;;)
+    {
+      // Tasks only take unreserved threads, and not while a gang is waiting
+      // for threads to free up, so a stream of tasks cannot starve gangs
+      m_wake.wait(guard, [this]
+      {
+        return m_members.size() > 0 || (m_tasks.size() > 0 && m_free > 0 && m_gangs.size() == 0) ||
+               (m_stop && m_tasks.size() == 0 && m_gangs.size() == 0);
+      });
+
+      if (m_members.size() > 0)
+      {
+        Member member = m_members.front();
+        m_members.pop_front();
+        guard.unlock();
+
+        std::exception_ptr error;
+        try
+        {
+          member.gang->fn(member.index);
+        }
+        catch (...)
+        {
+          error = std::current_exception();
+        }
+
+        guard.lock();
+        Gang& gang = *member.gang;
+        if (error && !gang.error)
+          gang.error = error;
+        if (--gang.remaining == 0)
+        {
+          if (gang.error)
+            gang.done.set_exception(gang.error);
+          else
+            gang.done.set_value();
+        }
+        ++m_free;
+      }
+      else if (m_tasks.size() > 0 && m_free > 0 && m_gangs.size() == 0)
+      {
+        std::function<void()> task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        --m_free;
+        guard.unlock();
+
+        // packaged_task stores any exception in its future
+        task();
+
+        guard.lock();
+        ++m_free;
+      }
+      else
+        return;
+
+      // This thread is free again, which may let a waiting gang start
+      schedule();
+      if (m_members.size() > 0)
+        m_wake.notify_all();
+      else if (m_tasks.size() > 0)
+        m_wake.notify_one();
+    }
+  }
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::deque<std::shared_ptr<Gang>> m_gangs;
+  std::deque<Member> m_members;
+  unsigned m_free;
+  bool m_stop;
+  std::mutex m_lock;
+  std::condition_variable m_wake;
+};
+
+#endif
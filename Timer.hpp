@@ -43,4 +43,28 @@ private:
   point m_stop;
 };
 
+// Wall-clock cutoff for budgeted searches. A budget of 0 never expires.
+class Deadline
+{
+  using clock = std::chrono::steady_clock;
+  using point = clock::time_point;
+  using duration = std::chrono::duration<double, std::milli>;
+
+public:
+  Deadline(double budgetMs)
+    : m_unlimited(budgetMs <= 0),
+      m_end(clock::now() + std::chrono::duration_cast<clock::duration>(duration(budgetMs)))
+  { }
+
+  bool
+  expired() const
+  {
+    return !m_unlimited && clock::now() >= m_end;
+  }
+
+private:
+  bool m_unlimited;
+  point m_end;
+};
+
 #endif
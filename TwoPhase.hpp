@@ -0,0 +1,245 @@
+/*
+ * Sean Malloy
+ * TwoPhase.hpp
+ * Tables for the second phase of a two-phase solve. Phase one brings a cube
+ * into the subgroup <U, D, R2, L2, F2, B2>, where every piece is oriented
+ * and the E-slice edges are in the E slice (see
+ * CoordTables::phaseOneBound()). Phase two solves it with those ten moves
+ * only. A state there is tracked by its corner permutation and the
+ * permutations of the eight U/D edges and of the four slice edges, and is
+ * bounded by two pruning tables of 8! x 4! entries.
+ *
+ * The combined solution is not optimal, but both searches finish in
+ * milliseconds, so this finds a first solution to any cube quickly.
+ */
+
+#ifndef TWO_PHASE_HPP
+#define TWO_PHASE_HPP
+
+/************************************************/
+// System includes
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Coordinates.hpp"
+#include "Peephole.hpp"
+
+/************************************************/
+
+const unsigned PHASE_TWO_MOVE_COUNT = 10;
+const unsigned SLICE_PERM_COUNT     = 24;    // 4!
+
+// Diameters of the two phases
+const size_t MAX_PHASE_ONE_DEPTH = 12;
+const size_t MAX_PHASE_TWO_DEPTH = 18;
+
+struct PhaseTwoState
+{
+  uint16_t corners;
+  uint16_t edges;
+  uint16_t slice;
+};
+
+/************************************************/
+
+class PhaseTwoTables
+{
+public:
+  PhaseTwoTables()
+    : m_codes(),
+      m_udSlots(),
+      m_sliceSlots(),
+      m_cornerMove(CORNER_PERM_COUNT * PHASE_TWO_MOVE_COUNT),
+      m_edgeMove(CORNER_PERM_COUNT * PHASE_TWO_MOVE_COUNT),
+      m_sliceMove(SLICE_PERM_COUNT * PHASE_TWO_MOVE_COUNT),
+      m_cornerSlice(),
+      m_edgeSlice()
+  {
+    const unsigned up = strchr(MOVE_NAMES, 'U') - MOVE_NAMES, down = strchr(MOVE_NAMES, 'D') - MOVE_NAMES;
+    for (uint8_t code = 0; code < START_MOVE_COUNT; ++code)
+      if (codeFace(code) == up || codeFace(code) == down || codeTurns(code) == 2)
+        m_codes.push_back(code);
+
+    const CoordTables& coords = CoordTables::instance();
+    for (unsigned e = 0; e < EDGE_COUNT; ++e)
+      (coords.isSliceEdge(e) ? m_sliceSlots : m_udSlots).push_back(e);
+
+    buildMoves(m_cornerMove, CORNER_PERM_COUNT,
+               [](unsigned v) { return Cube::fromCornerRank(v * CORNER_ORIENT_COUNT); },
+               [this](const Cube& c) { return fromCube(c).corners; });
+    buildMoves(m_edgeMove, CORNER_PERM_COUNT,
+               [this](unsigned v) { return edgeCube(v, 0); },
+               [this](const Cube& c) { return fromCube(c).edges; });
+    buildMoves(m_sliceMove, SLICE_PERM_COUNT,
+               [this](unsigned v) { return edgeCube(0, v); },
+               [this](const Cube& c) { return fromCube(c).slice; });
+
+    buildPruning(m_cornerSlice, [this](uint32_t i, unsigned m)
+                 {
+                   return m_cornerMove[i / SLICE_PERM_COUNT * PHASE_TWO_MOVE_COUNT + m] * SLICE_PERM_COUNT +
+                          m_sliceMove[i % SLICE_PERM_COUNT * PHASE_TWO_MOVE_COUNT + m];
+                 });
+    buildPruning(m_edgeSlice, [this](uint32_t i, unsigned m)
+                 {
+                   return m_edgeMove[i / SLICE_PERM_COUNT * PHASE_TWO_MOVE_COUNT + m] * SLICE_PERM_COUNT +
+                          m_sliceMove[i % SLICE_PERM_COUNT * PHASE_TWO_MOVE_COUNT + m];
+                 });
+  }
+
+  // Shared tables, built on first use
+  static const PhaseTwoTables&
+  instance()
+  {
+    static PhaseTwoTables tables;
+    return tables;
+  }
+
+  // Move code of phase-two move 'm' (see Peephole.hpp)
+  uint8_t
+  code(unsigned m) const
+  {
+    return m_codes[m];
+  }
+
+  // Only meaningful for cubes in the phase-two subgroup
+  PhaseTwoState
+  fromCube(const Cube& cube) const
+  {
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    cube.cubies(cp, co, ep, eo);
+
+    PhaseTwoState s;
+    s.corners = (uint16_t) cube.cornerPermRank();
+    s.edges = rankWithin(ep, m_udSlots);
+    s.slice = rankWithin(ep, m_sliceSlots);
+    return s;
+  }
+
+  // State after phase-two move 'm'
+  PhaseTwoState
+  move(const PhaseTwoState& s, unsigned m) const
+  {
+    PhaseTwoState next;
+    next.corners = m_cornerMove[s.corners * PHASE_TWO_MOVE_COUNT + m];
+    next.edges = m_edgeMove[s.edges * PHASE_TWO_MOVE_COUNT + m];
+    next.slice = m_sliceMove[s.slice * PHASE_TWO_MOVE_COUNT + m];
+    return next;
+  }
+
+  // Admissible within the subgroup, and 0 only when solved
+  unsigned
+  lowerBound(const PhaseTwoState& s) const
+  {
+    unsigned corners = m_cornerSlice[s.corners * SLICE_PERM_COUNT + s.slice];
+    unsigned edges = m_edgeSlice[s.edges * SLICE_PERM_COUNT + s.slice];
+    return corners > edges ? corners : edges;
+  }
+
+private:
+  // Lehmer rank of the cubies in 'slots', each numbered by its own position
+  // in 'slots'
+  static uint16_t
+  rankWithin(const unsigned ep[EDGE_COUNT], const std::vector<unsigned>& slots)
+  {
+    unsigned r = 0;
+    for (unsigned i = 0; i < slots.size(); ++i)
+    {
+      unsigned smaller = 0;
+      for (unsigned j = i + 1; j < slots.size(); ++j)
+        smaller += ep[slots[j]] < ep[slots[i]];
+      r = r * (slots.size() - i) + smaller;
+    }
+
+    return (uint16_t) r;
+  }
+
+  // Inverse of rankWithin() over 'slots', writing the cubies into 'ep'
+  static void
+  unrankWithin(unsigned r, const std::vector<unsigned>& slots, unsigned ep[EDGE_COUNT])
+  {
+    std::vector<unsigned> digits(slots.size()), free(slots);
+    for (unsigned base = 1; base <= slots.size(); ++base)
+    {
+      digits[slots.size() - base] = r % base;
+      r /= base;
+    }
+
+    for (unsigned i = 0; i < slots.size(); ++i)
+    {
+      ep[slots[i]] = free[digits[i]];
+      free.erase(free.begin() + digits[i]);
+    }
+  }
+
+  // Solved corners with the U/D edges ranked 'edges' and the slice edges
+  // ranked 'slice'
+  Cube
+  edgeCube(unsigned edges, unsigned slice) const
+  {
+    unsigned cp[CORNER_COUNT], co[CORNER_COUNT], ep[EDGE_COUNT], eo[EDGE_COUNT];
+    Cube().cubies(cp, co, ep, eo);
+    unrankWithin(edges, m_udSlots, ep);
+    unrankWithin(slice, m_sliceSlots, ep);
+    return Cube::fromCubies(cp, co, ep, eo);
+  }
+
+  template<typename Make, typename Read>
+  void
+  buildMoves(std::vector<uint16_t>& table, unsigned count, Make make, Read read) const
+  {
+    for (unsigned v = 0; v < count; ++v)
+    {
+      Cube cube = make(v);
+      for (unsigned m = 0; m < PHASE_TWO_MOVE_COUNT; ++m)
+      {
+        Cube child(cube);
+        child.turn(codeFace(m_codes[m]), codeTurns(m_codes[m]));
+        table[v * PHASE_TWO_MOVE_COUNT + m] = read(child);
+      }
+    }
+  }
+
+  // Breadth-first distances from solved (index 0) over permutation x slice
+  // pairs
+  template<typename Next>
+  static void
+  buildPruning(std::vector<uint8_t>& table, Next next)
+  {
+    table.assign(CORNER_PERM_COUNT * SLICE_PERM_COUNT, UNVISITED);
+    table[0] = 0;
+
+    std::vector<uint32_t> layer(1, 0);
+    for (uint8_t depth = 1; layer.size() > 0; ++depth)
+    {
+      std::vector<uint32_t> following;
+      for (uint32_t i : layer)
+        for (unsigned m = 0; m < PHASE_TWO_MOVE_COUNT; ++m)
+        {
+          uint32_t j = next(i, m);
+          if (table[j] == UNVISITED)
+          {
+            table[j] = depth;
+            following.push_back(j);
+          }
+        }
+
+      layer.swap(following);
+    }
+  }
+
+  movecode_t m_codes;
+  std::vector<unsigned> m_udSlots;
+  std::vector<unsigned> m_sliceSlots;
+  std::vector<uint16_t> m_cornerMove;
+  std::vector<uint16_t> m_edgeMove;
+  std::vector<uint16_t> m_sliceMove;
+  std::vector<uint8_t> m_cornerSlice;
+  std::vector<uint8_t> m_edgeSlice;
+};
+
+#endif
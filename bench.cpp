@@ -0,0 +1,355 @@
+/*
+ * Sean Malloy
+ * bench.cpp
+ * Throughput microbenchmarks for Cube primitives.
+ */
+/************************************************/
+// System includes
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/************************************************/
+// Local includes
+#include "Cube.hpp"
+#include "Constants.h"
+#include "Timer.hpp"
+#include "RandomState.hpp"
+#include "CubeBatch.hpp"
+#include "Coordinates.hpp"
+#include "MoveGroup.hpp"
+#include "Solver.hpp"
+
+/************************************************/
+
+const unsigned BENCH_STATE_COUNT = 1 << 16;
+const unsigned BENCH_REPEATS     = 16;
+const unsigned SCRAMBLE_LENGTH   = 30;
+const unsigned RANDOM_STATES     = 1 << 22;
+const unsigned RANDOM_SCRAMBLES  = 1 << 12;
+const unsigned BATCH_SIZE        = 256;
+const unsigned GROUP_SCRAMBLES   = 64;
+const unsigned RUF_SCRAMBLES     = 8;
+const unsigned ANYTIME_STATES    = 32;
+const double ANYTIME_BUDGET_MS   = 200;
+
+// Random-move scrambled cubes to benchmark against
+std::vector<Cube>
+makeStates(unsigned count, unsigned seed)
+{
+  const std::string faces = MOVE_NAMES;
+  const std::string variants[3] = { "", "'", "2" };
+
+  std::mt19937 rng(seed);
+  std::vector<Cube> states(count);
+  for (auto& cube : states)
+    for (unsigned i = 0; i < SCRAMBLE_LENGTH; ++i)
+      cube.move(faces[rng() % SIDE_COUNT] + variants[rng() % 3]);
+
+  return states;
+}
+
+void
+report(const char* name, unsigned ops, double ms)
+{
+  printf("%-16s %10.2f Mops/s  (%.1f ns/op)\n", name, ops / ms / 1000, ms * 1e6 / ops);
+}
+
+// Ranks and unranks every state, checking each round trip so the compiler
+// cannot drop the work.
+void
+benchRank(const std::vector<Cube>& states)
+{
+  std::vector<rank_t> ranks(states.size());
+  unsigned ops = states.size() * BENCH_REPEATS;
+  Timer t;
+
+  t.start();
+  for (unsigned r = 0; r < BENCH_REPEATS; ++r)
+    for (size_t i = 0; i < states.size(); ++i)
+      ranks[i] = states[i].rank();
+  t.stop();
+  report("rank", ops, t.elapsed());
+
+  uint64_t check = 0;
+  t.start();
+  for (unsigned r = 0; r < BENCH_REPEATS; ++r)
+    for (size_t i = 0; i < states.size(); ++i)
+      check += states[i].cornerRank();
+  t.stop();
+  report("cornerRank", ops, t.elapsed());
+
+  t.start();
+  for (unsigned r = 0; r < BENCH_REPEATS; ++r)
+    for (size_t i = 0; i < states.size(); ++i)
+      check += states[i].edgeRank();
+  t.stop();
+  report("edgeRank", ops, t.elapsed());
+
+  size_t mismatches = 0;
+  t.start();
+  for (unsigned r = 0; r < BENCH_REPEATS; ++r)
+    for (size_t i = 0; i < states.size(); ++i)
+      if (!(Cube::fromRank(ranks[i]) == states[i]))
+        ++mismatches;
+  t.stop();
+  report("fromRank", ops, t.elapsed());
+
+  if (mismatches > 0 || check == 0)
+  {
+    fprintf(stderr, "rank round trip failed for %zu states\n", mismatches);
+    exit(1);
+  }
+}
+
+// Uniform state generation on one thread and on every hardware thread, and
+// scramble construction. A sample of scrambles is replayed against the state
+// it was built for.
+void
+benchRandom()
+{
+  std::vector<Cube> states(RANDOM_STATES);
+  unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+  Timer t;
+
+  t.start();
+  generateRandomStates(states.data(), states.size(), 476, 1);
+  t.stop();
+  report("random x1", states.size(), t.elapsed());
+
+  t.start();
+  generateRandomStates(states.data(), states.size(), 476, hw);
+  t.stop();
+  report(("random x" + std::to_string(hw)).c_str(), states.size(), t.elapsed());
+
+  ScrambleBuilder::instance();
+  t.start();
+  std::vector<moveset_t> scrambles = generateRandomScrambles(RANDOM_SCRAMBLES, 476, hw);
+  t.stop();
+  report("scramble", scrambles.size(), t.elapsed());
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < scrambles.size(); ++i)
+  {
+    Cube cube;
+    for (const auto& m : scrambles[i])
+      cube.move(m);
+    if (!(cube == states[i]))
+      ++mismatches;
+  }
+
+  if (mismatches > 0)
+  {
+    fprintf(stderr, "scrambles do not reproduce %zu states\n", mismatches);
+    exit(1);
+  }
+}
+
+// Turns every state by each of the 18 moves and takes its lower bound, one
+// cube at a time and then BATCH_SIZE cubes at a time through CubeBatch. The
+// bound sums must agree.
+void
+benchBatch(const std::vector<Cube>& states)
+{
+  unsigned ops = states.size() * START_MOVE_COUNT;
+  uint64_t scalarSum = 0, batchSum = 0;
+  Timer t;
+
+  t.start();
+  for (const auto& cube : states)
+    for (unsigned m = 0; m < START_MOVE_COUNT; ++m)
+    {
+      Cube child(cube);
+      child.turn(m / 3, m % 3 + 1);
+      scalarSum += child.movesLowerBound();
+    }
+  t.stop();
+  report("turn+bound", ops, t.elapsed());
+
+  CubeBatch parents(BATCH_SIZE), children(BATCH_SIZE);
+  std::vector<uint8_t> bounds(parents.capacity());
+  t.start();
+  for (size_t begin = 0; begin < states.size(); begin += BATCH_SIZE)
+  {
+    parents.clear();
+    for (size_t i = begin; i < std::min(states.size(), begin + BATCH_SIZE); ++i)
+      parents.push(states[i]);
+
+    for (unsigned m = 0; m < START_MOVE_COUNT; ++m)
+    {
+      children.assignTurned(parents, m / 3, m % 3 + 1);
+      children.lowerBounds(bounds.data());
+      for (size_t c = 0; c < children.size(); ++c)
+        batchSum += bounds[c];
+    }
+  }
+  t.stop();
+  report("batch turn+bound", ops, t.elapsed());
+
+  if (scalarSum != batchSum)
+  {
+    fprintf(stderr, "batch bounds differ (%llu vs %llu)\n", (unsigned long long) batchSum,
+            (unsigned long long) scalarSum);
+    exit(1);
+  }
+}
+
+// Builds the coordinate tables, then moves the coordinates of every state by
+// each of the 18 moves and takes the table bound. The moved coordinates must
+// match the coordinates of the turned cubes.
+void
+benchCoords(const std::vector<Cube>& states)
+{
+  unsigned ops = states.size() * START_MOVE_COUNT;
+  Timer t;
+
+  t.start();
+  const CoordTables& tables = CoordTables::instance();
+  t.stop();
+  printf("%-16s %10.1f ms\n", "coord tables", t.elapsed());
+
+  std::vector<CoordState> coords;
+  for (const auto& cube : states)
+    coords.push_back(tables.fromCube(cube));
+
+  uint64_t sum = 0;
+  t.start();
+  for (const auto& c : coords)
+    for (uint8_t m = 0; m < START_MOVE_COUNT; ++m)
+      sum += tables.lowerBound(tables.move(c, m));
+  t.stop();
+  report("coord move+bound", ops, t.elapsed());
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < states.size(); ++i)
+    for (uint8_t m = 0; m < START_MOVE_COUNT; ++m)
+    {
+      Cube child(states[i]);
+      child.turn(m / 3, m % 3 + 1);
+      CoordState expected = tables.fromCube(child), moved = tables.move(coords[i], m);
+      if (expected.twist != moved.twist || expected.flip != moved.flip || expected.cornerPerm != moved.cornerPerm ||
+          expected.slice != moved.slice)
+        ++mismatches;
+    }
+
+  if (mismatches > 0)
+  {
+    fprintf(stderr, "moved coordinates differ for %zu children (bound sum %llu)\n", mismatches,
+            (unsigned long long) sum);
+    exit(1);
+  }
+}
+
+// Builds the tables of move group MOVES, then solves random scrambles made of
+// its moves. Each solution must solve its cube and be no longer than the
+// scramble. Uses 'count' scrambles since RUF solves take seconds each.
+template<uint32_t MOVES>
+void
+benchGroup(const char* name, unsigned count)
+{
+  Timer t;
+  char label[32];
+
+  t.start();
+  const GroupSolver<MOVES>& solver = GroupSolver<MOVES>::instance();
+  t.stop();
+  snprintf(label, sizeof(label), "%s tables", name);
+  printf("%-16s %10.1f ms (%zu entries)\n", label, t.elapsed(), solver.tableEntries());
+
+  constexpr auto codes = groupCodes<MOVES>();
+  std::mt19937 rng(476);
+  std::vector<Cube> cubes(count);
+  for (auto& cube : cubes)
+    for (unsigned i = 0; i < SCRAMBLE_LENGTH; ++i)
+    {
+      uint8_t code = codes[rng() % codes.size()];
+      cube.turn(codeFace(code), codeTurns(code));
+    }
+
+  std::vector<moveset_t> solutions(cubes.size());
+  std::vector<bool> solved(cubes.size());
+  t.start();
+  for (size_t i = 0; i < cubes.size(); ++i)
+    solved[i] = solver.solve(cubes[i], solutions[i]);
+  t.stop();
+  snprintf(label, sizeof(label), "%s solve", name);
+  printf("%-16s %10.3f ms/solve\n", label, t.elapsed() / cubes.size());
+
+  for (size_t i = 0; i < cubes.size(); ++i)
+  {
+    Cube cube(cubes[i]);
+    for (const auto& m : solutions[i])
+      cube.move(m);
+    if (!solved[i] || !solver.contains(cubes[i]) || !cube.isSolved() || solutions[i].size() > SCRAMBLE_LENGTH)
+    {
+      fprintf(stderr, "%s solution %zu is wrong\n", name, i);
+      exit(1);
+    }
+  }
+}
+
+// Gives the anytime solver a short budget on uniformly random states, which
+// are too deep for it to finish. Each must still return a solution that
+// solves its cube.
+void
+benchAnytime()
+{
+  Solver solver(1);
+  SolveOptions options;
+  options.algorithm = "anytime";
+  options.budgetMs = ANYTIME_BUDGET_MS;
+  solver.prepare(options);
+
+  std::vector<Cube> states(ANYTIME_STATES);
+  generateRandomStates(states.data(), states.size(), 476, 1);
+
+  size_t moves = 0;
+  for (size_t i = 0; i < states.size(); ++i)
+  {
+    SolveResult result = solver.solve(states[i], options);
+    Cube cube(states[i]);
+    for (const auto& m : result.solution)
+      cube.move(m);
+    if (!result.found || !cube.isSolved())
+    {
+      fprintf(stderr, "anytime found no solution to random state %zu in %.0f ms\n", i, ANYTIME_BUDGET_MS);
+      exit(1);
+    }
+
+    moves += result.solution.size();
+  }
+
+  printf("%-16s %10.1f moves (%.0f ms budget)\n", "anytime", moves / (double) states.size(), ANYTIME_BUDGET_MS);
+}
+
+/************************************************/
+
+int
+main(int argc, char* argv[])
+{
+  std::string which = argc > 1 ? argv[1] : "all";
+  std::vector<Cube> states = makeStates(BENCH_STATE_COUNT, 476);
+
+  if (which == "all" || which == "rank")
+    benchRank(states);
+  if (which == "all" || which == "batch")
+    benchBatch(states);
+  if (which == "all" || which == "coords")
+    benchCoords(states);
+  if (which == "all" || which == "random")
+    benchRandom();
+  if (which == "all" || which == "group")
+  {
+    benchGroup<GROUP_RU>("ru", GROUP_SCRAMBLES);
+    benchGroup<GROUP_HALF>("half", GROUP_SCRAMBLES);
+    benchGroup<GROUP_RUF>("ruf", RUF_SCRAMBLES);
+  }
+  if (which == "all" || which == "anytime")
+    benchAnytime();
+
+  return 0;
+}
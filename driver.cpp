@@ -2,149 +2,83 @@
  * Sean Malloy
  * CSCI 476 - Project
  * 3x3x3 Cube Solver using BFS and A*
+ * Command line client of the solver library (Solver.hpp).
  */
 /************************************************/
 // System includes
 #include <iostream>
 #include <string>
 #include <vector>
-#include <queue>
-#include <mutex>
-#include <future>
-#include <stack>
+#include <algorithm>
+#include <thread>
+#include <cstdint>
+#include <cstdlib>
 
 /************************************************/
 // Local includes
+#include "Solver.hpp"
 #include "Cube.hpp"
 #include "Constants.h"
 #include "Timer.hpp"
+#include "Cluster.hpp"
+#include "PerfCounters.hpp"
+#include "RandomState.hpp"
+#include "MemoryBudget.hpp"
 
 /************************************************/
-// Typedefs/structs
-typedef std::vector<std::string> moveset_t;
+// Forward declarations
 
-struct CubeState
-{
-  CubeState()
-    : cube(),
-      solution()
-  { }
-
-  CubeState(const Cube& otherCube)
-    : cube(otherCube),
-      solution()
-  { }
-
-  CubeState(const CubeState& state)
-    : cube(state.cube),
-      solution(state.solution)
-  { }
-
-  bool
-  operator<(const CubeState& state) const
-  {
-    return cube < state.cube;
-  }
+// Command line entry point for cluster modes:
+//   driver --coordinator PORT ALGORITHM [THREADS [BUDGET_MS [TIMEOUT_MS]]]
+//   driver --worker HOST PORT
+// The coordinator reads one scramble per line from stdin and prints one
+// solution per line in the same order.
+int
+runCluster(int argc, char* argv[]);
 
-  void
-  printSolution()
-  {
-    for (const auto& m : solution)
-      std::cout << m << ' ';
-  }
-  
-  Cube cube;
-  moveset_t solution;
-};
+// Command line entry point for test corpora:
+//   driver --random COUNT [SEED [THREADS]]
+// Prints scrambles of COUNT uniformly random states, one per line, in the
+// same format the coordinator reads. The output depends only on SEED.
+int
+printRandomScrambles(int argc, char* argv[]);
 
-typedef std::queue<CubeState> frontierBFS_t;
-typedef std::priority_queue<CubeState> frontierAStar_t;
-typedef std::stack<CubeState> frontierID_t;
+// Prints optimal solutions as they are found, stopping after 'maxSolutions'
+// (0 for all of them). Uses 'p' workers, or a serial search when 'p' is 0.
+int
+printOptimalSolutions(Solver& solver, const Cube& cube, unsigned p, size_t maxSolutions);
 
-/************************************************/
-// Forward declarations
+// Solves a single cluster job inside a worker process. THREADS of 0 runs
+// the serial version of the algorithm.
+std::string
+solveJob(Solver& solver, const Job& job);
 
-moveset_t
-serialID(Cube& cube);
-
-moveset_t
-serialIDHelper(frontierID_t& frontier, const moveset_t& moves, size_t maxDepth);
-
-moveset_t
-parallelID(Cube& cube, unsigned p);
-
-CubeState
-parallelIDHelper(frontierID_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, size_t maxDepth);
-
-// Returns strings representing all start moves based on face names.
-moveset_t
-getStartMoves(const std::string& faceNames);
-
-// Serial Breadth-First Search. First level is populated with every possible
-// starting move. Each vertex is one CubeState struct instance with a copy of
-// cube and a solution vector.
-moveset_t
-serialBFS(Cube& cube);
-
-// Serial Breadth-First search helper that searches all nodes after the inital
-// starting moves. Only adds states to the frontier if the moves don't show
-// they are looping infinitely, saving space. Returns first solution that is
-// found.
-moveset_t
-serialBFSHelper(frontierBFS_t& frontier, const moveset_t& moves);
-
-// Parallel Breadth-First Search using std::future. First level is populated
-// with every possible starting move, and partitioned to 'p' threads. Those
-// threads then search their section of the graph until a solution is found by
-// one of the threads. That solution is returned and all other states are
-// ignored.
-moveset_t
-parallelBFS(Cube& cube, unsigned p);
-
-// Parallel Breadth-First search helper where each node searches their section
-// of the graph. Only adds states to the frontier if the moves don't show they
-// are looping infinitely, saving space. Returns once one thread finishes (i.e.
-// solution is at front of local frontier), indicated by the shared bool 'finished'.
-CubeState
-parallelBFSHelper(frontierBFS_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock);
-
-// Serial A* search, adapted from BFS.
-moveset_t
-serialAStar(Cube& cube);
-
-// Serial A* search helper, adapted from BFS that uses a std::priority_queue instead
-// of a std::queue and returns as soon as a solution is found rather than
-// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic.
-moveset_t
-serialAStarHelper(frontierAStar_t& frontier, const moveset_t& moves);
-
-// Parallel A* search, adapted from parallel BFS.
-moveset_t
-parallelAStar(Cube& cube, unsigned p);
-
-// Parallel A* search helper, adapted from BFS that uses a std::priority_queue instead
-// of a std::queue and returns as soon as a solution is found rather than
-// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic
-CubeState
-parallelAStarHelper(frontierAStar_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock);
-
-// Returns true if same move is not being done more than once in a row, or when
-// opposite face is moved before it.
-bool
-uniqueMoves(const char face, const moveset_t& solution);
-
-// Returns letter representing opposite face of 'face'
-char
-oppositeFace(const char face);
-
-// Partition calculation used for chunking starting move vector.
-unsigned
-partitionStart(const unsigned p, const unsigned tid);
 /************************************************/
 
 int
-main()
+main(int argc, char* argv[])
 {
+  // --max-mem SIZE may come first in any mode
+  if (argc > 2 && std::string(argv[1]) == "--max-mem")
+  {
+    size_t limit = MemoryGovernor::parseSize(argv[2]);
+    if (limit == 0)
+    {
+      fprintf(stderr, "Invalid memory cap (%s)\n", argv[2]);
+      return 1;
+    }
+
+    MemoryGovernor::instance().setLimit(limit);
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+
+  if (argc > 1 && std::string(argv[1]) == "--random")
+    return printRandomScrambles(argc, argv);
+  if (argc > 1)
+    return runCluster(argc, argv);
+
   std::cout << "Scramble => ";
   std::string scramble;
   std::getline(std::cin, scramble);
@@ -153,591 +87,241 @@ main()
   std::string version;
   std::cin >> version;
 
-  std::cout << "Algorithm (bfs/astar/itdeep) => ";
+  std::cout << "Algorithm (bfs/astar/itdeep/anytime/all/ru/ruf/half/group) => ";
   std::string algorithm;
   std::cin >> algorithm;
-
-  Cube cube;
-  cube.scramble(scramble);
-  
-  Timer t;
-  moveset_t solution;
-  unsigned p;
-  if (version == "s")
+  if (algorithm != "all" && !Solver::hasAlgorithm(algorithm))
   {
-    if (algorithm == "bfs")
-    {
-      t.start();
-      solution = serialBFS(cube);
-      t.stop();
-    }
-    else if (algorithm == "astar")
-    {
-      t.start();
-      solution = serialAStar(cube);
-      t.stop();
-    }
-    else
-    {
-      t.start();
-      solution = serialID(cube);
-      t.stop();
-    }
-  }
-  else
-  {
-    std::cout << "p => ";
-    std::cin >> p;
-
-    if (algorithm == "bfs")
-    {
-      t.start();
-      solution = parallelBFS(cube, p);
-      t.stop();
-    }
-    else if (algorithm == "astar")
-    {
-      t.start();
-      solution = parallelAStar(cube, p);
-      t.stop();
-    }
-    else
-    {
-      t.start();
-      solution = parallelID(cube, p);
-      t.stop();
-    }
+    fprintf(stderr, "Unknown algorithm (%s)\n", algorithm.c_str());
+    return 1;
   }
 
-  std::cout << "\nSolution: ";
-  for (const auto& m : solution)
-    std::cout << m << ' ';
-  std::cout << '\n';
-
-  printf("Time: %.3f ms\n", t.elapsed());
-  
-  return 0;
-}
-
-/************************************************/
-
-// Returns strings representing all start moves based on face names.
-moveset_t
-getStartMoves(const std::string& faceNames)
-{
-  moveset_t moves;
-  std::string variants = "2\'";
-
-  for (const char faceChar : faceNames)
+  unsigned p = 0;
+  double budgetMs = 0;
+  size_t nodeBudget = 0;
+  size_t maxSolutions = 0;
+  if (algorithm == "anytime")
   {
-    std::string face;
-    face += faceChar;
-    moves.push_back(face);
+    std::cout << "Budget (ms, 0 = none) => ";
+    std::cin >> budgetMs;
 
-    for (const char var : variants)
-      moves.push_back(face + var);
+    std::cout << "Node budget (0 = none) => ";
+    std::cin >> nodeBudget;
   }
-
-  return moves;
-}
-
-/************************************************/
-
-// Serial Depth-First Search. First level is populated with every possible
-// starting move. Each vertex is one CubeState struct instance with a copy of
-// cube and a solution vector.
-moveset_t
-serialID(Cube& cube)
-{
-  if (cube.isSolved())
-    return moveset_t();
-
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
-  frontierID_t frontier;
-
-  for (const auto& move : initMoves)
+  else if (version != "s")
   {
-    CubeState state(cube);
-    state.cube.move(move);
-    state.solution.push_back(move);
-
-    if (state.cube.isSolved())
-      return state.solution;
-
-    frontier.push(state);
+    std::cout << "p => ";
+    std::cin >> p;
   }
 
-  for (size_t i = 2; i <= 20; ++i)
+  if (algorithm == "all")
   {
-    std::cout << "Current depth: " << i << '\n';
-    frontierID_t frontierCopy = frontier;
-    moveset_t sol = serialIDHelper(frontierCopy, initMoves, i);
-    if (sol.size() > 0)
-      return sol;
+    std::cout << "Max solutions (0 = all) => ";
+    std::cin >> maxSolutions;
   }
 
-  return moveset_t();
-}
-
-/************************************************/
+  SolveOptions options;
+  options.algorithm = algorithm;
+  options.threads = p;
+  options.budgetMs = budgetMs;
+  options.nodeBudget = nodeBudget;
 
-// Serial Breadth-First search helper that searches all nodes after the inital
-// starting moves. Only adds states to the frontier if the moves don't show
-// they are looping infinitely, saving space. Returns at first found solution.
-moveset_t
-serialIDHelper(frontierID_t& frontier, const moveset_t& moves, size_t maxDepth)
-{
-  while (frontier.size() > 0)
+  // The driver owns the process, so its workers are pinned
+  Cube cube;
+  Solver solver(std::max(p, 1u), 1, true);
   {
-    auto curr = frontier.top();
-    frontier.pop();
+    PerfScope scope("setup");
+    cube.scramble(scramble);
 
-    if (curr.solution.size() < maxDepth) 
-    {
-      for (const auto& move : moves)
-      {
-        if (uniqueMoves(move[0], curr.solution))
-        {
-          CubeState copyState(curr);
-          copyState.cube.move(move);
-          copyState.solution.push_back(move);
-          
-          if (copyState.cube.isSolved())
-            return copyState.solution;
-
-          frontier.push(copyState);
-        }
-      }
-    }
+    // Build the tables before timing if the solver will use them
+    solver.prepare(options);
   }
 
-  return moveset_t();
-}
-
-moveset_t
-parallelID(Cube& cube, unsigned p)
-{
-  if (cube.isSolved())
-    return moveset_t();
-
-  bool finished = false;
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
-  CubeState solved;
-
-  for (size_t i = 2; i <= 20; ++i) {
-    std::cout << "Current depth: " << i << '\n';
-    std::vector<std::future<CubeState>> threads;
-    std::mutex lock;
-    for (unsigned tid = 0; tid < p; ++tid)
-    {
-      frontierID_t frontier;
-      for (unsigned m = partitionStart(p, tid); m < partitionStart(p, tid + 1); ++m)
-      {
-        CubeState state(cube);
-        state.cube.move(initMoves[m]);
-        state.solution.push_back(initMoves[m]);
-
-        frontier.push(state);
-      }
-
-      threads.push_back(std::async(std::launch::async, parallelIDHelper, 
-            frontier, std::cref(initMoves), std::ref(finished), std::ref(lock), i));
-    }
+  if (algorithm == "all")
+    return printOptimalSolutions(solver, cube, p, maxSolutions);
 
-    bool foundSolved = false;
-    for (auto& t : threads)
-    {
-      CubeState state = t.get();
-      if (!foundSolved && state.solution.size() > 0 && state.cube.isSolved())
-      {
-        foundSolved = true;
-        solved = state;
-      }
-    }
-
-    if (foundSolved)
-      break;
+  Timer t;
+  SolveResult result;
+  {
+    PerfScope scope("solve");
+    t.start();
+    result = solver.solve(cube, options);
+    t.stop();
   }
-  return solved.solution;
-}
+  const moveset_t& solution = result.solution;
 
-CubeState
-parallelIDHelper(frontierID_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock, size_t maxDepth)
-{
-  while (!finished && frontier.size() > 0)
   {
-    auto curr = frontier.top();
-    frontier.pop();
-    
-    if (curr.solution.size() < maxDepth) 
+    PerfScope scope("output");
+    if (result.boundedFallback)
+      std::cout << "\nMemory cap of " << MemoryGovernor::instance().limit()
+                << " bytes reached, finished with bounded-memory search";
+    if (algorithm == "anytime")
     {
-      for (const auto& move : moves)
-      {
-        if (uniqueMoves(move[0], curr.solution))
-        {
-          CubeState copyState(curr);
-          copyState.cube.move(move);
-          copyState.solution.push_back(move);      
-          
-          if (!finished && copyState.cube.isSolved())
-          {
-            lock.lock();
-            finished = true;
-            lock.unlock();
-            return copyState;
-          }
-
-          frontier.push(copyState);
-        }
-      }
+      if (!result.found)
+        std::cout << "\nNo solution found within budget";
+      else
+        std::cout << "\nOptimal: " << (result.optimal ? "proven" : "not proven");
+      std::cout << " (" << result.expanded << " nodes expanded)";
     }
-  }
-
-  return CubeState();
-}
+    else if (!result.found && (algorithm == "ru" || algorithm == "ruf" || algorithm == "half"))
+      std::cout << "\nNot solvable within the " << algorithm << " move group";
 
+    std::cout << "\nSolution: ";
+    for (const auto& m : solution)
+      std::cout << m << ' ';
+    std::cout << '\n';
 
-
-
-
-
-
-
-/************************************************/
-
-// Serial Breadth-First Search. First level is populated with every possible
-// starting move. Each vertex is one CubeState struct instance with a copy of
-// cube and a solution vector.
-moveset_t
-serialBFS(Cube& cube)
-{
-  if (cube.isSolved())
-    return moveset_t();
-
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
-  frontierBFS_t frontier;
-
-  for (const auto& move : initMoves)
-  {
-    CubeState state(cube);
-    state.cube.move(move);
-    state.solution.push_back(move);
-
-    if (state.cube.isSolved())
-      return state.solution;
-
-    frontier.push(state);
+    printf("Time: %.3f ms\n", t.elapsed());
+    printf("Peak memory: %.1f MiB\n", MemoryGovernor::instance().peak() / 1048576.0);
   }
 
-  return serialBFSHelper(frontier, initMoves);
-}
-
-/************************************************/
+  PerfProfile::instance().print(stdout);
 
-// Serial Breadth-First search helper that searches all nodes after the inital
-// starting moves. Only adds states to the frontier if the moves don't show
-// they are looping infinitely, saving space. Returns at first found solution.
-moveset_t
-serialBFSHelper(frontierBFS_t& frontier, const moveset_t& moves)
-{
-  while (true)
-  {
-    for (const auto& move : moves)
-    {
-      if (uniqueMoves(move[0], frontier.front().solution))
-      {
-        CubeState copyState(frontier.front());
-        copyState.cube.move(move);
-        copyState.solution.push_back(move);
-        
-        if (copyState.cube.isSolved())
-          return copyState.solution;
-
-        frontier.push(copyState);
-      }
-    }
-    
-    frontier.pop();
-  }
+  return 0;
 }
 
 /************************************************/
 
-// Parallel Breadth-First Search using std::future. First level is populated
-// with every possible starting move, and partitioned to 'p' threads. Those
-// threads then search their section of the graph until a solution is found by
-// one of the threads. That solution is returned and all other states are
-// ignored.
-moveset_t
-parallelBFS(Cube& cube, unsigned p)
+// Command line entry point for cluster modes:
+//   driver --coordinator PORT ALGORITHM [THREADS [BUDGET_MS [TIMEOUT_MS]]]
+//   driver --worker HOST PORT
+// The coordinator reads one scramble per line from stdin and prints one
+// solution per line in the same order.
+int
+runCluster(int argc, char* argv[])
 {
-  if (cube.isSolved())
-    return moveset_t();
-
-  bool finished = false;
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
-
-  std::vector<std::future<CubeState>> threads;
-  std::mutex lock;
-  for (unsigned tid = 0; tid < p; ++tid)
+  std::string mode = argv[1];
+  // Each table is built by the first job that needs it and shared by the
+  // rest of the process's jobs
+  if (mode == "--worker" && argc == 4)
   {
-    frontierBFS_t frontier;
-    for (unsigned m = partitionStart(p, tid); m < partitionStart(p, tid + 1); ++m)
-    {
-      CubeState state(cube);
-      state.cube.move(initMoves[m]);
-      state.solution.push_back(initMoves[m]);
-
-      frontier.push(state);
-    }
-
-    threads.push_back(std::async(std::launch::async, parallelBFSHelper, 
-          frontier, std::cref(initMoves), std::ref(finished), std::ref(lock)));
+    Solver solver(0, 1, true);
+    return runWorker(argv[2], argv[3], [&solver](const Job& job) { return solveJob(solver, job); });
   }
 
-  bool foundSolved = false;
-  CubeState solved;
-  for (auto& t : threads)
+  if (mode == "--coordinator" && argc >= 4 && argc <= 7)
   {
-    CubeState state = t.get();
-    if (!foundSolved && state.cube.isSolved())
+    if (!Solver::hasAlgorithm(argv[3]))
     {
-      foundSolved = true;
-      solved = state;
+      fprintf(stderr, "Unknown algorithm (%s)\n", argv[3]);
+      return 1;
     }
-  }
 
-  return solved.solution;
-}
-/************************************************/
+    uint16_t port = (uint16_t) atoi(argv[2]);
+    uint32_t threads = argc > 4 ? (uint32_t) atoi(argv[4]) : 0;
+    uint32_t budgetMs = argc > 5 ? (uint32_t) atoi(argv[5]) : 0;
+    double timeoutMs = argc > 6 ? atof(argv[6]) : 10000;
 
-// Parallel Breadth-First search helper where each node searches their section
-// of the graph. Only adds states to the frontier if the moves don't show they
-// are looping infinitely, saving space. Returns once one thread finishes (i.e.
-// solution is at front of local frontier), indicated by the shared bool 'finished'.
-CubeState
-parallelBFSHelper(frontierBFS_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock)
-{
-  while (!finished)
-  {
-    for (const auto& move : moves)
+    std::vector<Job> jobs;
+    std::vector<size_t> invalid;
+    std::string scramble;
+    for (size_t line = 1; std::getline(std::cin, scramble); ++line)
     {
-      if (uniqueMoves(move[0], frontier.front().solution))
+      if (scramble.size() == 0)
+        continue;
+
+      Job job;
+      job.id = jobs.size();
+      job.threads = threads;
+      job.budgetMs = budgetMs;
+      job.algorithm = argv[3];
+      job.scramble = scramble;
+      jobs.push_back(job);
+
+      // Still a job, so the output keeps one line per input line
+      if (!Cube::validScramble(scramble))
       {
-        CubeState copyState(frontier.front());
-        copyState.cube.move(move);
-        copyState.solution.push_back(move);        
-        
-        if (!finished && copyState.cube.isSolved())
-        { 
-          lock.lock();
-          finished = true;
-          lock.unlock();
-          return copyState;
-        }
-
-        frontier.push(copyState);
+        fprintf(stderr, "Invalid scramble on line %zu (%s)\n", line, scramble.c_str());
+        invalid.push_back(job.id);
       }
     }
 
-    frontier.pop();
+    Coordinator coordinator(jobs, timeoutMs);
+    for (size_t id : invalid)
+      coordinator.reject(id);
+    return coordinator.run(port, std::cout);
   }
 
-  return frontier.front();
+  fprintf(stderr, "Usage: %s --coordinator PORT ALGORITHM [THREADS [BUDGET_MS [TIMEOUT_MS]]] < scrambles\n"
+                  "       %s --worker HOST PORT\n", argv[0], argv[0]);
+  return 1;
 }
 
 /************************************************/
 
-// Serial A* adapted from BFS.
-moveset_t
-serialAStar(Cube& cube)
+// Command line entry point for test corpora:
+//   driver --random COUNT [SEED [THREADS]]
+// Prints scrambles of COUNT uniformly random states, one per line, in the
+// same format the coordinator reads. The output depends only on SEED.
+int
+printRandomScrambles(int argc, char* argv[])
 {
-  if (cube.isSolved())
-    return moveset_t();
-
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
-  frontierAStar_t frontier;
-
-  for (const auto& move : initMoves)
+  if (argc < 3 || argc > 5)
   {
-    CubeState state(cube);
-    state.cube.move(move);
-    state.solution.push_back(move);
-    
-    if (state.cube.isSolved())
-      return state.solution;
-
-    frontier.push(state);
+    fprintf(stderr, "Usage: %s --random COUNT [SEED [THREADS]]\n", argv[0]);
+    return 1;
   }
 
-  return serialAStarHelper(frontier, initMoves);
-}
-
-/************************************************/
+  size_t count = strtoull(argv[2], nullptr, 10);
+  uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : 0;
+  unsigned threads = argc > 4 ? (unsigned) atoi(argv[4]) : std::thread::hardware_concurrency();
 
-// Serial A* search helper, adapted from BFS that uses a std::priority_queue instead
-// of a std::queue and returns as soon as a solution is found rather than
-// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic.
-moveset_t
-serialAStarHelper(frontierAStar_t& frontier, const moveset_t& moves)
-{
-  frontierAStar_t temp;
-  while (!frontier.top().cube.isSolved())
-  {
-    if (frontier.size() == 0)
-    {
-      frontier = temp;
-      temp = frontierAStar_t();
-    }
-
-    for (const auto& move : moves)
-    {
-      if (uniqueMoves(move[0], frontier.top().solution))
-      {
-        CubeState copyState(frontier.top());
-        copyState.cube.move(move);
-        copyState.solution.push_back(move);
-        
-        if (copyState.cube.isSolved())
-          return copyState.solution;
-
-        temp.push(copyState);
-      }
-    }
-    
-    frontier.pop();
-  }
-
-  return frontier.top().solution;
+  writeRandomScrambles(std::cout, count, seed, threads);
+  return 0;
 }
 
 /************************************************/
 
-// Parallel A* adapted from parallel BFS.
-moveset_t
-parallelAStar(Cube& cube, unsigned p)
+// Prints optimal solutions as they are found, stopping after 'maxSolutions'
+// (0 for all of them). Uses 'p' workers, or a serial search when 'p' is 0.
+int
+printOptimalSolutions(Solver& solver, const Cube& cube, unsigned p, size_t maxSolutions)
 {
-  if (cube.isSolved())
-    return moveset_t();
-
-  bool finished = false;
-  moveset_t initMoves = getStartMoves(MOVE_NAMES);
+  Timer t;
+  t.start();
 
-  std::vector<std::future<CubeState>> threads;
-  std::mutex lock;
-  for (unsigned tid = 0; tid < p; ++tid)
+  std::cout << '\n';
+  size_t count = 0;
+  solver.enumerateOptimal(cube, p, [&count, maxSolutions](const moveset_t& solution)
   {
-    frontierAStar_t frontier;
-    for (unsigned m = partitionStart(p, tid); m < partitionStart(p, tid + 1); ++m)
-    {
-      CubeState state(cube);
-      state.cube.move(initMoves[m]);
-      state.solution.push_back(initMoves[m]);
+    std::cout << "Solution " << ++count << ": ";
+    for (const auto& m : solution)
+      std::cout << m << ' ';
+    std::cout << '\n';
 
-      frontier.push(state);
-    }
+    return maxSolutions == 0 || count < maxSolutions;
+  }, true);
+  t.stop();
 
-    threads.push_back(std::async(std::launch::async, parallelAStarHelper,
-          frontier, std::cref(initMoves), std::ref(finished), std::ref(lock)));
-  }
+  std::cout << count << " optimal solution(s)\n";
+  printf("Time: %.3f ms\n", t.elapsed());
 
-  bool foundSolved = false;
-  CubeState solved;
-  for (auto& t : threads)
-  {
-    CubeState state = t.get();
-    if (!foundSolved && state.cube.isSolved())
-    {
-      foundSolved = true;
-      solved = state;
-    }
-  }
+  PerfProfile::instance().print(stdout);
 
-  return solved.solution;
+  return 0;
 }
 
 /************************************************/
 
-// Parallel A* search helper, adapted from BFS that uses a std::priority_queue instead
-// of a std::queue and returns as soon as a solution is found rather than
-// waiting for it to be at the top of the queue. Check Cube.hpp for heuristic
-CubeState
-parallelAStarHelper(frontierAStar_t frontier, const moveset_t& moves, bool& finished, std::mutex& lock)
+// Solves a single cluster job inside a worker process. THREADS of 0 runs
+// the serial version of the algorithm.
+std::string
+solveJob(Solver& solver, const Job& job)
 {
-  frontierAStar_t temp;
-  while (!finished)
-  {
-    if (frontier.size() == 0)
-    {
-      frontier = temp;
-      temp = frontierAStar_t();
-    }
-
-    for (const auto& move : moves)
-    {
-      if (uniqueMoves(move[0], frontier.top().solution))
-      {
-        CubeState copyState(frontier.top());
-        copyState.cube.move(move);
-        copyState.solution.push_back(move);
-        
-        if (copyState.cube.isSolved())
-        {
-          lock.lock();
-          finished = true;
-          lock.unlock();
-
-          return copyState;
-        }
-
-        temp.push(copyState);
-      }
-    }
-    
-    frontier.pop();
-  }
-
-  return frontier.top();
-}
-/************************************************/
+  Cube cube;
+  cube.scramble(job.scramble);
 
-// Returns true if same move is not being done more than once in a row, or when
-// opposite face is moved before it.
-bool
-uniqueMoves(const char face, const moveset_t& solution)
-{
-  return (face != solution.back()[0] && !(solution.size() >= 3 && face == solution[solution.size() - 3][0] && 
-      solution[solution.size() - 2][0] == oppositeFace(face)));
-}
+  SolveOptions options;
+  options.algorithm = job.algorithm;
+  options.threads = job.threads;
+  options.budgetMs = job.budgetMs;
 
-/************************************************/
+  // Builds the tables before an anytime budget starts running, not inside it
+  solver.prepare(options);
 
-// Returns letter representing opposite face of 'face'
-char
-oppositeFace(const char face)
-{
-  switch (face)
-  {
-    case 'U':
-      return 'D';
-    case 'D':
-      return 'U';
-    case 'R':
-      return 'L';
-    case 'L':
-      return 'R';
-    case 'F':
-      return 'B';
-    default:
-      return 'F';
-  }
-}
+  std::string joined;
+  for (const auto& m : solver.solve(cube, options).solution)
+    joined += (joined.size() > 0 ? " " : "") + m;
 
-/************************************************/
-
-// Partition calculation used for chunking starting move vector.
-unsigned
-partitionStart(const unsigned p, const unsigned tid)
-{
-  return START_MOVE_COUNT * tid / p;
+  return joined;
 }